@@ -0,0 +1,128 @@
+/** @file
+  Implementacja wsadowego wykonywania wielu plików z instrukcjami.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include "batch.h"
+#include "work_pool.h"
+
+/**
+ * Struktura przechowująca stan wykonania wsadowego.
+ */
+typedef struct Batch {
+    const BatchConfig *config; ///< ustawienia
+    pthread_mutex_t lock;      ///< blokada chroniąca pola done plików
+    pthread_cond_t done;       ///< sygnalizuje wykonanie pliku
+} Batch;
+
+/**
+ * Struktura przechowująca wykonanie jednego pliku.
+ */
+typedef struct BatchFile {
+    Batch *batch;     ///< wykonanie wsadowe
+    const char *path; ///< ścieżka pliku
+    char *out;        ///< zebrane wyniki
+    size_t out_len;   ///< długość wyników
+    char *err;        ///< zebrane komunikaty o błędach
+    size_t err_len;   ///< długość komunikatów o błędach
+    bool failed;      ///< czy nie udało się wykonać pliku
+    bool done;        ///< czy wykonanie się zakończyło
+} BatchFile;
+
+/**
+ * Wykonuje instrukcje z otwartego pliku nowym kalkulatorem.
+ * @param[in] f : wykonanie pliku
+ * @param[in] in : plik
+ * @param[in] out : strumień wyników
+ * @param[in] err : strumień komunikatów o błędach
+ */
+static void runCalculator(BatchFile *f, FILE *in, FILE *out, FILE *err) {
+    Calculator *calc = makeCalculator(out, err);
+    if (configureCalculator(calc, &f->batch->config->calc) != CALC_OK) {
+        fprintf(err, "tmpfile: %s\n", strerror(errno));
+        f->failed = true;
+    }
+    else {
+        char *string = NULL;
+        ssize_t bytes_read;
+        size_t size = 0;
+        while ((bytes_read = getline(&string, &size, in)) != -1)
+            takeLine(calc, string, bytes_read);
+        free(string);
+    }
+    destroyCalculator(calc);
+}
+
+/**
+ * Zadanie puli: wykonuje plik i zbiera jego wyniki w pamięci.
+ * @param[in] arg : wykonanie pliku
+ */
+static void runFile(void *arg) {
+    BatchFile *f = arg;
+    FILE *out = open_memstream(&f->out, &f->out_len);
+    FILE *err = open_memstream(&f->err, &f->err_len);
+    if (out == NULL || err == NULL)
+        exit(1);
+    FILE *in = fopen(f->path, "r");
+    if (in == NULL) {
+        fprintf(err, "%s: %s\n", f->path, strerror(errno));
+        f->failed = true;
+    }
+    else {
+        runCalculator(f, in, out, err);
+        fclose(in);
+    }
+    fclose(out);
+    fclose(err);
+
+    Batch *batch = f->batch;
+    pthread_mutex_lock(&batch->lock);
+    f->done = true;
+    pthread_cond_broadcast(&batch->done);
+    pthread_mutex_unlock(&batch->lock);
+}
+
+int runBatch(const BatchConfig *config) {
+    Batch batch = {.config = config};
+    pthread_mutex_init(&batch.lock, NULL);
+    pthread_cond_init(&batch.done, NULL);
+    BatchFile *files = calloc(config->count, sizeof(BatchFile));
+    if (files == NULL)
+        exit(1);
+
+    WorkPool *pool = WorkPoolMake(config->jobs);
+    // wątki zabierają zadania dodane z zewnątrz w kolejności dodania, więc
+    // wyniki mogą być wypisywane, zanim skończą się wszystkie pliki
+    for (size_t i = 0; i < config->count; i++) {
+        files[i] = (BatchFile) {.batch = &batch, .path = config->paths[i]};
+        WorkPoolSubmit(pool, runFile, &files[i]);
+    }
+
+    int ret = 0;
+    for (size_t i = 0; i < config->count; i++) {
+        BatchFile *f = &files[i];
+        pthread_mutex_lock(&batch.lock);
+        while (!f->done)
+            pthread_cond_wait(&batch.done, &batch.lock);
+        pthread_mutex_unlock(&batch.lock);
+        fwrite(f->out, 1, f->out_len, stdout);
+        fwrite(f->err, 1, f->err_len, stderr);
+        free(f->out);
+        free(f->err);
+        if (f->failed)
+            ret = 1;
+    }
+    fflush(stdout);
+
+    WorkPoolDestroy(pool);
+    pthread_mutex_destroy(&batch.lock);
+    pthread_cond_destroy(&batch.done);
+    free(files);
+    return ret;
+}
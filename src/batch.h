@@ -0,0 +1,39 @@
+/** @file
+  Interfejs wsadowego wykonywania wielu plików z instrukcjami.
+
+  Każdy plik jest wykonywany przez osobny kalkulator (z własnym stosem),
+  jako zadanie puli wątków z podkradaniem zadań. Wyniki i komunikaty
+  o błędach każdego pliku są zbierane w pamięci i wypisywane na
+  standardowe wyjście i standardowe wyjście błędów w kolejności plików,
+  więc są identyczne z wynikami kolejnych uruchomień programu dla
+  poszczególnych plików. Dotyczy to także budżetu pamięci: każdy
+  kalkulator ma własny budżet (CalcOptions.memory), więc pliki wykonywane
+  współbieżnie nie zużywają nawzajem swojej pamięci.
+*/
+
+#ifndef _BATCH_H
+#define _BATCH_H
+
+#include <stddef.h>
+#include "calculator.h"
+
+/**
+ * Struktura przechowująca ustawienia wykonania wsadowego.
+ */
+typedef struct BatchConfig {
+    char **paths;     ///< ścieżki plików
+    size_t count;     ///< liczba plików
+    unsigned jobs;    ///< liczba wątków (0 - liczba procesorów)
+    CalcOptions calc; ///< ustawienia kalkulatorów
+} BatchConfig;
+
+/**
+ * Wykonuje wszystkie pliki i wypisuje ich wyniki w kolejności plików.
+ * Plik, którego nie udało się otworzyć, jest zgłaszany na standardowe
+ * wyjście błędów.
+ * @param[in] config : ustawienia
+ * @return 0, jeśli wszystkie pliki zostały wykonane, 1 w przeciwnym razie
+ */
+int runBatch(const BatchConfig *config);
+
+#endif //_BATCH_H
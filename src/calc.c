@@ -1,60 +1,234 @@
-#include "stack.h"
-#include "poly.h"
-#include "poly_from_text.h"
-#include "poly_to_text.h"
-#include "instructions_reader.h"
+#include "calculator.h"
+#include "monos.h"
+#include "poly_reclaim.h"
+#include "poly_trace.h"
+#include "server.h"
+#include "batch.h"
+#include <signal.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
+#include <errno.h>
 
-#define STACK_INIT_SIZE 8
+/** Domyślna liczba elementów z wierzchu stosu, które nie są wyrzucane do pliku. */
+#define SPILL_DEFAULT_DEPTH 8
 
-int main(){
-    long line_nr = 0;
-    char *string = NULL;
-    ssize_t bytes_read;
-    size_t size = 0;
-    Stack *st = makeStack(STACK_INIT_SIZE);
+/**
+ * Wypisuje informację o sposobie wywołania programu.
+ * @param[in] prog : nazwa programu
+ */
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [--cache BYTES] [--lazy] [--reclaim BYTES] [--trace FILE]\n"
+            "          [--memory BYTES] [--freeze] [--restore FILE]\n"
+            "          [--spill BYTES] [--spill-depth N]\n"
+            "          [--server PATH [--workers N] [--session-memory BYTES]\n"
+            "          [--session-time SECONDS]]\n"
+            "          [--jobs N] [FILE...]\n", prog);
+}
 
-    do {
-        line_nr++;
-        bytes_read = getline(&string, &size, stdin);
-        if (bytes_read == -1) {
-            break;
-        }
+/** Działający serwer, zatrzymywany sygnałem. */
+static Server *running_server = NULL;
 
-        if (*string == '#' || strcmp(string, "\n") == 0 || strcmp(string, "") == 0) {
-            if (strlen(string) < bytes_read) {      //przypadek znaku \0 na początku linii
-                fprintf(stderr,"ERROR %ld WRONG POLY\n", line_nr);
-            }
-            continue;
-        }
+/**
+ * Zatrzymuje działający serwer po otrzymaniu sygnału.
+ * @param[in] sig : numer sygnału
+ */
+static void handleStop(int sig) {
+    (void)sig;
+    stopServer(running_server);
+}
+
+/**
+ * Konwertuje podany string na rozmiar w bajtach.
+ * Dopuszczalne są przyrostki K, M i G.
+ * @param[in] str : string
+ * @param[out] bytes : sparsowany rozmiar
+ * @return Czy parsowanie powiodło się?
+ */
+static bool parseBytes(const char *str, size_t *bytes) {
+    char *end;
+    errno = 0;
+    unsigned long long n = strtoull(str, &end, 10);
+    if (end == str || *str == '-' || errno == ERANGE)
+        return false;
+    if (*end == 'K')
+        n <<= 10;
+    else if (*end == 'M')
+        n <<= 20;
+    else if (*end == 'G')
+        n <<= 30;
+    else if (*end != 0)
+        return false;
+    if (*end != 0 && end[1] != 0)
+        return false;
+    *bytes = n;
+    return true;
+}
+
+/**
+ * Konwertuje podany string na nieujemną liczbę sekund.
+ * @param[in] str : string
+ * @param[out] seconds : sparsowana liczba sekund
+ * @return Czy parsowanie powiodło się?
+ */
+static bool parseSeconds(const char *str, double *seconds) {
+    char *end;
+    errno = 0;
+    double t = strtod(str, &end);
+    if (end == str || *end != 0 || errno == ERANGE || !(t >= 0))
+        return false;
+    *seconds = t;
+    return true;
+}
+
+/**
+ * Obsługuje połączenia z gniazdem uniksowym, aż do sygnału SIGINT lub SIGTERM.
+ * @param[in] config : ustawienia serwera
+ * @return kod wyjścia programu
+ */
+static int serve(const ServerConfig *config) {
+    running_server = makeServer(config);
+    if (running_server == NULL) {
+        perror(config->path);
+        return 1;
+    }
+    signal(SIGINT, handleStop);
+    signal(SIGTERM, handleStop);
+    runServer(running_server);
+    destroyServer(running_server);
+    running_server = NULL;
+    return 0;
+}
 
-        if (isLetter(*string)) {
-            if (strlen(string) < bytes_read) {
-                fprintf(stderr,"ERROR %ld WRONG COMMAND\n", line_nr);
-                continue;
+int main(int argc, char **argv) {
+    const char *restore_path = NULL;
+    ServerConfig server = {.path = NULL};
+    BatchConfig batch = {.count = 0};
+    bool jobs = false;
+    CalcOptions options = {.spill_depth = SPILL_DEFAULT_DEPTH};
+    for (int i = 1; i < argc; i++) {
+        size_t bytes;
+        if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc && parseBytes(argv[i + 1], &bytes)) {
+            options.cache = bytes;
+            i++;
+        }
+        else if (strcmp(argv[i], "--reclaim") == 0 && i + 1 < argc && parseBytes(argv[i + 1], &bytes)) {
+            PolyReclaimInit(bytes);
+            i++;
+        }
+        else if (strcmp(argv[i], "--memory") == 0 && i + 1 < argc && parseBytes(argv[i + 1], &bytes)) {
+            options.memory = bytes;
+            i++;
+        }
+        else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            if (!TraceInit(argv[i + 1])) {
+                perror(argv[i + 1]);
+                return 1;
             }
-            takeInstruction(string, st, line_nr);
+            i++;
+        }
+        else if (strcmp(argv[i], "--lazy") == 0) {
+            options.lazy = true;
+        }
+        else if (strcmp(argv[i], "--freeze") == 0) {
+            options.freeze = true;
+        }
+        else if (strcmp(argv[i], "--spill") == 0 && i + 1 < argc && parseBytes(argv[i + 1], &bytes)) {
+            options.spill = true;
+            options.spill_target = bytes;
+            i++;
+        }
+        else if (strcmp(argv[i], "--spill-depth") == 0 && i + 1 < argc && parseBytes(argv[i + 1], &bytes)) {
+            options.spill_depth = bytes;
+            i++;
+        }
+        else if (strcmp(argv[i], "--restore") == 0 && i + 1 < argc) {
+            restore_path = argv[i + 1];
+            i++;
+        }
+        else if (strcmp(argv[i], "--server") == 0 && i + 1 < argc) {
+            server.path = argv[i + 1];
+            i++;
+        }
+        else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc && parseBytes(argv[i + 1], &bytes)
+                 && bytes <= 1024) {
+            server.workers = (unsigned)bytes;
+            i++;
+        }
+        else if (strcmp(argv[i], "--session-memory") == 0 && i + 1 < argc && parseBytes(argv[i + 1], &bytes)) {
+            server.session_memory = bytes;
+            i++;
+        }
+        else if (strcmp(argv[i], "--session-time") == 0 && i + 1 < argc
+                 && parseSeconds(argv[i + 1], &server.session_time)) {
+            i++;
+        }
+        else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc && parseBytes(argv[i + 1], &bytes)
+                 && bytes <= 1024) {
+            batch.jobs = (unsigned)bytes;
+            jobs = true;
+            i++;
+        }
+        else if (strncmp(argv[i], "--", 2) != 0) {
+            // pliki są zapamiętywane za nazwą programu, na już przejrzanych pozycjach argv
+            argv[1 + batch.count++] = argv[i];
         }
-
         else {
-            if (strlen(string) < bytes_read) {
-                fprintf(stderr,"ERROR %ld WRONG POLY\n", line_nr);
-                continue;
-            }
-            Stack *poly_stack = makeStack(STACK_INIT_SIZE);
-            bool succ = true;
-            Poly p = stringToPoly(poly_stack, string, line_nr, &succ);
-            if (succ) {
-                Element e = elementOfPoly(&p);
-                push(st, e);
-            }
-            destroyStack(poly_stack);
+            usage(argv[0]);
+            return 1;
         }
     }
-        while (string != NULL);
 
-    destroyStack(st);
+    if ((jobs && batch.count == 0) || (batch.count > 0 && (server.path != NULL || restore_path != NULL))) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (batch.count > 0) {
+        batch.paths = argv + 1;
+        batch.calc = options;
+        int ret = runBatch(&batch);
+        PolyReclaimDestroy();
+        TraceFinish();
+        MonosPoolRelease();
+        return ret;
+    }
+
+    if (server.path != NULL) {
+        // sesje zaczynają od pustego stosu
+        if (restore_path != NULL) {
+            usage(argv[0]);
+            return 1;
+        }
+        server.calc = options;
+        int ret = serve(&server);
+        PolyReclaimDestroy();
+        TraceFinish();
+        MonosPoolRelease();
+        return ret;
+    }
+
+    Calculator *calc = makeCalculator(stdout, stderr);
+    if (configureCalculator(calc, &options) != CALC_OK) {
+        perror("tmpfile");
+        return 1;
+    }
+    if (restore_path != NULL && restoreCalculator(calc, restore_path) != CALC_OK) {
+        fprintf(stderr, "%s: cannot restore checkpoint\n", restore_path);
+        destroyCalculator(calc);
+        return 1;
+    }
+
+    char *string = NULL;
+    ssize_t bytes_read;
+    size_t size = 0;
+    while ((bytes_read = getline(&string, &size, stdin)) != -1)
+        takeLine(calc, string, bytes_read);
+
+    destroyCalculator(calc);
+    PolyReclaimDestroy();
+    TraceFinish();
     free(string);
+    MonosPoolRelease();
     return 0;
-}
\ No newline at end of file
+}
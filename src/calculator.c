@@ -0,0 +1,204 @@
+/** @file
+  Implementacja kalkulatora wielomianów wielu zmiennych.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "calculator.h"
+#include "instructions_reader.h"
+#include "poly_from_text.h"
+#include "poly_trace.h"
+#include "poly_reclaim.h"
+
+/** Początkowa pojemność stosów kalkulatora. */
+#define STACK_INIT_SIZE 8
+
+/** Najmniejsza liczba elementów z wierzchu stosu trzymanych zawsze w pamięci. */
+#define SPILL_MIN_DEPTH 3
+
+/** Opisy błędów o kolejnych kodach. */
+static const char *const error_messages[] = {
+    [CALC_OK] = "OK",
+    [CALC_STACK_UNDERFLOW] = "STACK UNDERFLOW",
+    [CALC_WRONG_COMMAND] = "WRONG COMMAND",
+    [CALC_WRONG_POLY] = "WRONG POLY",
+    [CALC_DEG_BY_WRONG_VARIABLE] = "DEG BY WRONG VARIABLE",
+    [CALC_AT_WRONG_VALUE] = "AT WRONG VALUE",
+    [CALC_ADD_N_WRONG_COUNT] = "ADD N WRONG COUNT",
+    [CALC_MUL_N_WRONG_COUNT] = "MUL N WRONG COUNT",
+    [CALC_MUL_TRUNC_WRONG_DEGREE] = "MUL TRUNC WRONG DEGREE",
+    [CALC_SWAP_VARS_WRONG_VARIABLE] = "SWAP VARS WRONG VARIABLE",
+    [CALC_CHECKPOINT_FAILED] = "CHECKPOINT FAILED",
+    [CALC_OUT_OF_MEMORY] = "OUT OF MEMORY",
+    [CALC_RESTORE_FAILED] = "RESTORE FAILED",
+    [CALC_SPILL_FAILED] = "SPILL FAILED",
+    [CALC_MEMORY_LIMIT] = "MEMORY LIMIT",
+    [CALC_TIME_LIMIT] = "TIME LIMIT",
+};
+
+Calculator *makeCalculator(FILE *out, FILE *err) {
+    Calculator *calc = calloc(1, sizeof(Calculator));
+    if (calc == NULL)
+        exit(1);
+    calc->stack = makeStack(STACK_INIT_SIZE);
+    calc->out = out;
+    calc->err = err;
+    calc->checkpoints = true;
+    MonosBudgetInit(&calc->budget, 0);
+    return calc;
+}
+
+void destroyCalculator(Calculator *calc) {
+    MonosBudget *budget = MonosUseBudget(&calc->budget);
+    // wielomiany ze stosu mogą leżeć w odwzorowanym punkcie kontrolnym,
+    // więc odwzorowanie jest usuwane na końcu
+    destroyStack(calc->stack);
+    PolyCacheDestroy(&calc->cache);
+    PolySpillDestroy(&calc->spill.file);
+    free(calc->spill.used);
+    releaseCheckpoint(&calc->image);
+    MonosUseBudget(budget);
+    // wielomiany usuwane w tle są odliczane od budżetu kalkulatora
+    PolyReclaimWait();
+    free(calc);
+}
+
+void setLazyMode(Calculator *calc, bool lazy) {
+    calc->lazy = lazy;
+}
+
+void setFreezeMode(Calculator *calc, bool freeze) {
+    calc->freeze = freeze;
+}
+
+void setCheckpoints(Calculator *calc, bool enabled) {
+    calc->checkpoints = enabled;
+}
+
+void setCacheLimit(Calculator *calc, size_t bytes) {
+    PolyCacheInit(&calc->cache, bytes);
+}
+
+void setMemoryLimit(Calculator *calc, size_t bytes) {
+    atomic_store(&calc->budget.limit, bytes);
+}
+
+void setTimeLimit(Calculator *calc, double seconds) {
+    MonosBudget *previous = MonosUseBudget(&calc->budget);
+    MonosSetTimeLimit(seconds);
+    MonosUseBudget(previous);
+}
+
+int initSpill(Calculator *calc, size_t depth, size_t target) {
+    if (!PolySpillInit(&calc->spill.file))
+        return CALC_SPILL_FAILED;
+    calc->spill.depth = depth < SPILL_MIN_DEPTH ? SPILL_MIN_DEPTH : depth;
+    calc->spill.target = target;
+    return CALC_OK;
+}
+
+int configureCalculator(Calculator *calc, const CalcOptions *options) {
+    setLazyMode(calc, options->lazy);
+    setFreezeMode(calc, options->freeze);
+    setCacheLimit(calc, options->cache);
+    setMemoryLimit(calc, options->memory);
+    if (options->spill)
+        return initSpill(calc, options->spill_depth, options->spill_target);
+    return CALC_OK;
+}
+
+size_t calculatorBytes(Calculator *calc) {
+    size_t bytes = 0;
+    for (size_t i = 0; i < size(calc->stack); i++) {
+        Element *e = &calc->stack->elements[i];
+        if (e->type == POLY)
+            bytes += MonosBytesOfPoly(&e->p);
+    }
+    return bytes;
+}
+
+double calculatorPoolTime(Calculator *calc) {
+    MonosBudget *previous = MonosUseBudget(&calc->budget);
+    double time = MonosChargedTime();
+    MonosUseBudget(previous);
+    return time;
+}
+
+int restoreCalculator(Calculator *calc, const char *path) {
+    if (calc->image.map != NULL || !restoreCheckpoint(calc->stack, path, &calc->image))
+        return CALC_RESTORE_FAILED;
+    MonosBudget *budget = MonosUseBudget(&calc->budget);
+    maintainStack(calc);
+    MonosUseBudget(budget);
+    return CALC_OK;
+}
+
+const char *calcErrorMessage(int code) {
+    if (code < 0 || (size_t)code >= sizeof(error_messages) / sizeof(error_messages[0]))
+        return "UNKNOWN ERROR";
+    return error_messages[code];
+}
+
+int calcError(Calculator *calc, int code) {
+    if (calc->err != NULL)
+        fprintf(calc->err, "ERROR %ld %s\n", calc->line_nr, calcErrorMessage(code));
+    return code;
+}
+
+/**
+ * Parsuje wielomian zapisany w wierszu i wkłada go na stos.
+ * @param[in] calc : kalkulator
+ * @param[in] line : wiersz
+ * @return CALC_OK lub kod błędu
+ */
+static int takePoly(Calculator *calc, char *line) {
+    Stack *poly_stack = makeStack(STACK_INIT_SIZE);
+    bool succ = true;
+    calc->mark = MonosBudgetMark();
+    Poly p = stringToPoly(poly_stack, line, &succ);
+    destroyStack(poly_stack);
+    if (!succ)
+        return calcError(calc, CALC_WRONG_POLY);
+    if (MonosOverBudgetSince(calc->mark)) {
+        PolyDestroy(&p);
+        return calcError(calc, CALC_OUT_OF_MEMORY);
+    }
+    push(calc->stack, elementOfPoly(&p));
+    maintainStack(calc);
+    return CALC_OK;
+}
+
+/**
+ * Obsługuje kolejny wiersz wejścia w budżecie pamięci kalkulatora.
+ * @param[in] calc : kalkulator
+ * @param[in] line : wiersz
+ * @param[in] length : długość wiersza
+ * @return CALC_OK lub kod błędu
+ */
+static int takeLineIn(Calculator *calc, char *line, size_t length) {
+    if (*line == '#' || strcmp(line, "\n") == 0 || strcmp(line, "") == 0) {
+        if (strlen(line) < length)      //przypadek znaku \0 na początku linii
+            return calcError(calc, CALC_WRONG_POLY);
+        return CALC_OK;
+    }
+
+    if (isLetter(*line)) {
+        if (strlen(line) < length)
+            return calcError(calc, CALC_WRONG_COMMAND);
+        return takeInstruction(calc, line);
+    }
+
+    if (strlen(line) < length)
+        return calcError(calc, CALC_WRONG_POLY);
+    return takePoly(calc, line);
+}
+
+int takeLine(Calculator *calc, char *line, size_t length) {
+    calc->line_nr++;
+    MonosBudget *budget = MonosUseBudget(&calc->budget);
+    long trace_line = TraceSetLine(calc->line_nr);
+    int ret = takeLineIn(calc, line, length);
+    TraceSetLine(trace_line);
+    MonosUseBudget(budget);
+    return ret;
+}
@@ -0,0 +1,238 @@
+/** @file
+  Interfejs kalkulatora wielomianów wielu zmiennych.
+
+  Cały stan kalkulatora (stos, ustawienia, pamięć podręczna, plik
+  wyrzucanych wielomianów i odwzorowanie punktu kontrolnego) jest
+  przechowywany w strukturze Calculator. Każdy kalkulator ma też własny
+  budżet pamięci: na czas obsługi wiersza jest on ustawiany jako budżet
+  bieżącego wątku (MonosUseBudget), razem z numerem wiersza dołączanym do
+  zdarzeń śledzenia, więc przekroczenie budżetu przez jeden kalkulator
+  nie wpływa na inne. Wiele kalkulatorów może działać współbieżnie
+  w jednym procesie, o ile każdego z nich używa naraz tylko jeden wątek.
+  Wspólne dla całego procesu pozostają: odroczone usuwanie wielomianów
+  (PolyReclaimInit) i plik śledzenia (TraceInit); oba są bezpieczne przy
+  wielu wątkach.
+  Wątek, który kończy pracę z kalkulatorami, powinien oddać pulę bloków
+  pamięci wywołaniem MonosPoolRelease.
+
+  Błędy są zgłaszane kodami CALC_*, a opcjonalnie także komunikatami
+  wypisywanymi na strumień błędów kalkulatora.
+*/
+
+#ifndef _CALCULATOR_H
+#define _CALCULATOR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "stack.h"
+#include "poly_cache.h"
+#include "poly_spill.h"
+#include "checkpoint.h"
+#include "monos.h"
+
+#define CALC_OK 0
+#define CALC_STACK_UNDERFLOW 1
+#define CALC_WRONG_COMMAND 2
+#define CALC_WRONG_POLY 3
+#define CALC_DEG_BY_WRONG_VARIABLE 4
+#define CALC_AT_WRONG_VALUE 5
+#define CALC_ADD_N_WRONG_COUNT 6
+#define CALC_MUL_N_WRONG_COUNT 7
+#define CALC_MUL_TRUNC_WRONG_DEGREE 8
+#define CALC_SWAP_VARS_WRONG_VARIABLE 9
+#define CALC_CHECKPOINT_FAILED 10
+#define CALC_OUT_OF_MEMORY 11
+#define CALC_RESTORE_FAILED 12
+#define CALC_SPILL_FAILED 13
+#define CALC_MEMORY_LIMIT 14
+#define CALC_TIME_LIMIT 15
+
+/**
+ * Struktura przechowująca ustawienia kalkulatora.
+ */
+typedef struct CalcOptions {
+    bool lazy;          ///< czy włączyć tryb leniwy
+    bool freeze;        ///< czy włączyć zamrażanie
+    size_t cache;       ///< limit pamięci podręcznej (0 - wyłączona)
+    size_t memory;      ///< budżet pamięci (0 - bez ograniczenia)
+    bool spill;         ///< czy włączyć wyrzucanie elementów stosu do pliku
+    size_t spill_depth; ///< liczba elementów z wierzchu stosu trzymanych w pamięci
+    size_t spill_target; ///< docelowa liczba bajtów wielomianów w pamięci
+} CalcOptions;
+
+/**
+ * Struktura przechowująca stan wyrzucania elementów stosu do pliku.
+ */
+typedef struct CalcSpill {
+    PolySpill file;      ///< plik tymczasowy
+    size_t depth;        ///< liczba elementów z wierzchu trzymanych w pamięci lub 0
+    size_t target;       ///< docelowa liczba bajtów wielomianów w pamięci
+    unsigned long clock; ///< liczba obsłużonych wierszy
+    unsigned long *used; ///< chwile ostatniego użycia kolejnych pozycji stosu
+    size_t capacity;     ///< pojemność tablicy used
+} CalcSpill;
+
+/**
+ * Struktura przechowująca kalkulator.
+ */
+typedef struct Calculator {
+    Stack *stack;          ///< stos kalkulatora
+    long line_nr;          ///< numer obecnie obsługiwanego wiersza
+    FILE *out;             ///< strumień wyników
+    FILE *err;             ///< strumień komunikatów o błędach lub NULL
+    bool lazy;             ///< czy dodawania i mnożenia są wykonywane leniwie
+    bool freeze;           ///< czy wielomiany pod wierzchem stosu są zamrażane
+    bool checkpoints;      ///< czy instrukcja CHECKPOINT może zapisywać pliki
+    MonosBudget budget;    ///< budżet pamięci wielomianów kalkulatora
+    unsigned long mark;    ///< znacznik budżetu pamięci z początku wiersza
+    PolyCache cache;       ///< pamięć podręczna wyników operacji
+    CalcSpill spill;       ///< wyrzucanie elementów stosu do pliku
+    CheckpointImage image; ///< odwzorowanie odtworzonego punktu kontrolnego
+} Calculator;
+
+/**
+ * Tworzy kalkulator z pustym stosem i domyślnymi ustawieniami.
+ * @param[in] out : strumień, na który są wypisywane wyniki instrukcji
+ * @param[in] err : strumień, na który są wypisywane komunikaty o błędach,
+ * lub NULL, jeśli błędy mają być zgłaszane tylko kodami
+ * @return kalkulator
+ */
+Calculator *makeCalculator(FILE *out, FILE *err);
+
+/**
+ * Usuwa kalkulator wraz z jego stosem, pamięcią podręczną, plikiem
+ * tymczasowym i odwzorowaniem punktu kontrolnego.
+ * @param[in] calc : kalkulator
+ */
+void destroyCalculator(Calculator *calc);
+
+/**
+ * Włącza lub wyłącza tryb leniwy. W trybie leniwym instrukcje ADD, SUB,
+ * NEG i MUL budują wyrażenia, które są obliczane dopiero przy pierwszej
+ * instrukcji potrzebującej ich wartości.
+ * @param[in] calc : kalkulator
+ * @param[in] lazy : czy włączyć tryb leniwy
+ */
+void setLazyMode(Calculator *calc, bool lazy);
+
+/**
+ * Włącza lub wyłącza zamrażanie wielomianów. Po każdej instrukcji
+ * duży wielomian leżący bezpośrednio pod wierzchem stosu jest zamrażany
+ * (PolyFreeze), żeby kolejne operacje czytające go korzystały z jednego
+ * ciągłego bloku pamięci.
+ * @param[in] calc : kalkulator
+ * @param[in] freeze : czy włączyć zamrażanie
+ */
+void setFreezeMode(Calculator *calc, bool freeze);
+
+/**
+ * Zezwala na instrukcję CHECKPOINT lub jej zabrania. Zabroniona instrukcja
+ * nie zapisuje pliku i kończy się błędem CHECKPOINT FAILED.
+ * @param[in] calc : kalkulator
+ * @param[in] enabled : czy instrukcja CHECKPOINT może zapisywać pliki
+ */
+void setCheckpoints(Calculator *calc, bool enabled);
+
+/**
+ * Włącza pamięć podręczną wyników operacji o podanym limicie pamięci.
+ * Limit równy 0 wyłącza pamięć podręczną.
+ * @param[in] calc : kalkulator
+ * @param[in] bytes : limit pamięci w bajtach
+ */
+void setCacheLimit(Calculator *calc, size_t bytes);
+
+/**
+ * Ustawia budżet pamięci kalkulatora. Instrukcja, podczas której pamięć
+ * zajmowana przez wielomiany kalkulatora przekroczy budżet, kończy się
+ * błędem OUT OF MEMORY i nie zmienia stosu.
+ * @param[in] calc : kalkulator
+ * @param[in] bytes : budżet w bajtach (0 oznacza brak ograniczenia)
+ */
+void setMemoryLimit(Calculator *calc, size_t bytes);
+
+/**
+ * Ogranicza czas procesora, który wątek wywołujący (razem z wątkami puli
+ * wykonującymi jego zadania) może zużyć na kolejne instrukcje kalkulatora. Instrukcja, podczas której limit minie, jest
+ * przerywana, kończy się błędem TIME LIMIT i nie zmienia stosu.
+ * @param[in] calc : kalkulator
+ * @param[in] seconds : limit w sekundach, liczony od teraz (0 oznacza brak
+ * ograniczenia)
+ */
+void setTimeLimit(Calculator *calc, double seconds);
+
+/**
+ * Włącza wyrzucanie elementów stosu do pliku tymczasowego. Po każdym
+ * wierszu, jeśli wielomiany zajmują więcej pamięci niż @p target bajtów,
+ * najdawniej używane wielomiany leżące głębiej niż @p depth elementów
+ * od wierzchu są zapisywane w pliku i usuwane z pamięci. Są wczytywane
+ * z powrotem, gdy instrukcja ich potrzebuje.
+ * @param[in] calc : kalkulator
+ * @param[in] depth : liczba elementów z wierzchu stosu trzymanych w pamięci
+ * @param[in] target : docelowa liczba bajtów wielomianów w pamięci
+ * @return CALC_OK lub CALC_SPILL_FAILED, jeśli nie udało się utworzyć pliku
+ */
+int initSpill(Calculator *calc, size_t depth, size_t target);
+
+/**
+ * Stosuje wszystkie podane ustawienia kalkulatora.
+ * @param[in] calc : kalkulator
+ * @param[in] options : ustawienia
+ * @return CALC_OK lub CALC_SPILL_FAILED
+ */
+int configureCalculator(Calculator *calc, const CalcOptions *options);
+
+/**
+ * Daje liczbę bajtów zajmowanych przez wielomiany ze stosu kalkulatora
+ * (bez nieobliczonych wyrażeń i wielomianów wyrzuconych do pliku).
+ * @param[in] calc : kalkulator
+ * @return liczba bajtów
+ */
+size_t calculatorBytes(Calculator *calc);
+
+/**
+ * Daje czas procesora zużyty przez wątki puli na obliczenia kalkulatora
+ * od ostatniego wywołania setTimeLimit z dodatnim limitem.
+ * @param[in] calc : kalkulator
+ * @return czas w sekundach
+ */
+double calculatorPoolTime(Calculator *calc);
+
+/**
+ * Odtwarza stos kalkulatora z punktu kontrolnego (zob. restoreCheckpoint).
+ * Można to zrobić co najwyżej raz, przed obsłużeniem pierwszego wiersza.
+ * @param[in] calc : kalkulator
+ * @param[in] path : ścieżka pliku
+ * @return CALC_OK lub CALC_RESTORE_FAILED
+ */
+int restoreCalculator(Calculator *calc, const char *path);
+
+/**
+ * Obsługuje kolejny wiersz wejścia: pomija komentarze i puste wiersze,
+ * wykonuje instrukcje i wkłada na stos wielomiany. Wiersze są numerowane
+ * kolejnymi wywołaniami od 1.
+ * @param[in] calc : kalkulator
+ * @param[in] line : wiersz (może kończyć się znakiem nowej linii)
+ * @param[in] length : długość wiersza, włącznie z ewentualnymi znakami
+ * '\0' wewnątrz, które czynią wiersz błędnym
+ * @return CALC_OK lub kod błędu
+ */
+int takeLine(Calculator *calc, char *line, size_t length);
+
+/**
+ * Daje opis błędu o podanym kodzie, taki jak w komunikatach kalkulatora.
+ * @param[in] code : kod błędu
+ * @return opis błędu
+ */
+const char *calcErrorMessage(int code);
+
+/**
+ * Zgłasza błąd w obecnie obsługiwanym wierszu: wypisuje komunikat na
+ * strumień błędów kalkulatora (jeśli jest) i daje kod błędu.
+ * @param[in] calc : kalkulator
+ * @param[in] code : kod błędu
+ * @return @p code
+ */
+int calcError(Calculator *calc, int code);
+
+#endif //_CALCULATOR_H
@@ -0,0 +1,149 @@
+/** @file
+  Implementacja punktów kontrolnych stosu kalkulatora.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "checkpoint.h"
+#include "monos.h"
+
+/** Znacznik na początku pliku punktu kontrolnego. */
+#define CHECKPOINT_MAGIC "POLYCKP1"
+
+/** Adres, pod którym plik punktu kontrolnego jest odwzorowywany. */
+#define CHECKPOINT_BASE 0x600000000000ULL
+
+/**
+ * Struktura przechowująca nagłówek pliku punktu kontrolnego.
+ */
+typedef struct CheckpointHeader {
+    char magic[8];        ///< znacznik CHECKPOINT_MAGIC
+    uint64_t base;        ///< adres, dla którego zapisano wskaźniki
+    uint64_t size;        ///< rozmiar pliku
+    uint64_t count;       ///< liczba wielomianów
+    uint32_t header_size; ///< rozmiar nagłówka tablicy jednomianów
+    uint32_t mono_size;   ///< rozmiar jednomianu
+} CheckpointHeader;
+
+/**
+ * Zapisuje do pliku blok zamrożonego wielomianu, przesuwając wskaźniki
+ * tak, jakby blok leżał pod podanym adresem.
+ * @param[in] f : plik
+ * @param[in] p : zamrożony wielomian
+ * @param[in] address : adres początku bloku w odwzorowanym pliku
+ * @return Czy zapis się powiódł?
+ */
+static bool writeBlock(FILE *f, const Poly *p, uint64_t address) {
+    const char *block = (const char *)MonosGetHeader(p->arr);
+    size_t bytes = MonosBytesOfPoly(p);
+    char *copy = malloc(bytes);
+    if (copy == NULL)
+        exit(1);
+    memcpy(copy, block, bytes);
+    MonosRelocateFrozen(copy, bytes, (uintptr_t)address - (uintptr_t)block, true);
+    bool ok = fwrite(copy, 1, bytes, f) == bytes;
+    free(copy);
+    return ok;
+}
+
+bool writeCheckpoint(Stack *st, const char *path) {
+    size_t count = size(st);
+    Poly *entries = malloc((count + 1) * sizeof(Poly));
+    if (entries == NULL)
+        exit(1);
+    uint64_t offset = sizeof(CheckpointHeader) + count * sizeof(Poly);
+    for (size_t i = 0; i < count; i++) {
+        Element *e = &st->elements[i];
+        assert(e->type == POLY);
+        PolyFreeze(&e->p);
+        entries[i] = e->p;
+        if (!PolyIsCoeff(&e->p)) {
+            entries[i].arr = (Mono *)(uintptr_t)(CHECKPOINT_BASE + offset + sizeof(MonosHeader));
+            offset += MonosBytesOfPoly(&e->p);
+        }
+    }
+
+    // plik jest zapisywany obok i podmieniany, bo stary plik może być
+    // właśnie odwzorowany w pamięć
+    size_t path_len = strlen(path);
+    char *tmp_path = malloc(path_len + 5);
+    if (tmp_path == NULL)
+        exit(1);
+    memcpy(tmp_path, path, path_len);
+    memcpy(tmp_path + path_len, ".tmp", 5);
+    FILE *f = fopen(tmp_path, "wb");
+    bool ok = f != NULL;
+    if (ok) {
+        CheckpointHeader h = {.base = CHECKPOINT_BASE, .size = offset, .count = count,
+                              .header_size = sizeof(MonosHeader), .mono_size = sizeof(Mono)};
+        memcpy(h.magic, CHECKPOINT_MAGIC, sizeof(h.magic));
+        ok = fwrite(&h, sizeof(h), 1, f) == 1 && fwrite(entries, sizeof(Poly), count, f) == count;
+        for (size_t i = 0; i < count && ok; i++) {
+            if (!PolyIsCoeff(&entries[i])) {
+                uint64_t address = (uint64_t)(uintptr_t)entries[i].arr - sizeof(MonosHeader);
+                ok = writeBlock(f, &st->elements[i].p, address);
+            }
+        }
+        ok = fclose(f) == 0 && ok;
+        ok = ok && rename(tmp_path, path) == 0;
+        if (!ok)
+            remove(tmp_path);
+    }
+    free(tmp_path);
+    free(entries);
+    return ok;
+}
+
+bool restoreCheckpoint(Stack *st, const char *path, CheckpointImage *image) {
+    assert(image->map == NULL);
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+    CheckpointHeader h;
+    struct stat sb;
+    if (pread(fd, &h, sizeof(h), 0) != sizeof(h) || memcmp(h.magic, CHECKPOINT_MAGIC, sizeof(h.magic)) != 0
+        || h.header_size != sizeof(MonosHeader) || h.mono_size != sizeof(Mono)
+        || fstat(fd, &sb) != 0 || (uint64_t)sb.st_size != h.size
+        || h.size < sizeof(CheckpointHeader) + h.count * sizeof(Poly)) {
+        close(fd);
+        return false;
+    }
+    void *map = mmap((void *)(uintptr_t)h.base, h.size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return false;
+    image->map = map;
+    image->size = h.size;
+
+    Poly *entries = (Poly *)((char *)map + sizeof(CheckpointHeader));
+    uintptr_t delta = (uintptr_t)map - (uintptr_t)h.base;
+    if (delta != 0) {
+        // adres był zajęty, więc wskaźniki trzeba przesunąć, co dotyka
+        // wszystkich stron pliku
+        size_t blocks = sizeof(CheckpointHeader) + h.count * sizeof(Poly);
+        for (size_t i = 0; i < h.count; i++) {
+            if (!PolyIsCoeff(&entries[i]))
+                entries[i].arr = (Mono *)((uintptr_t)entries[i].arr + delta);
+        }
+        MonosRelocateFrozen((char *)map + blocks, h.size - blocks, delta, true);
+    }
+    for (size_t i = 0; i < h.count; i++)
+        push(st, elementOfPoly(&entries[i]));
+    return true;
+}
+
+void releaseCheckpoint(CheckpointImage *image) {
+    if (image->map == NULL)
+        return;
+    munmap(image->map, image->size);
+    image->map = NULL;
+    image->size = 0;
+}
@@ -0,0 +1,60 @@
+/** @file
+  Interfejs punktów kontrolnych stosu kalkulatora.
+
+  Punkt kontrolny to plik z obrazem całego stosu: nagłówkiem, tablicą
+  wielomianów z kolejnych pozycji stosu i zamrożonymi blokami ich węzłów.
+  Wskaźniki w obrazie są zapisane tak, jakby plik leżał w pamięci pod
+  ustalonym adresem. Przy odtwarzaniu plik jest odwzorowywany w pamięć
+  pod tym adresem (prywatnie, z kopiowaniem przy zapisie), więc
+  wielomiany są dostępne od razu, bez czytania i przepisywania węzłów.
+  Tylko jeśli adres jest zajęty, wskaźniki są przesuwane.
+
+  Plik może odtworzyć tylko program zbudowany dla tej samej architektury
+  i z tymi samymi strukturami wielomianów.
+*/
+
+#ifndef _CHECKPOINT_H
+#define _CHECKPOINT_H
+
+#include <stdbool.h>
+#include "stack.h"
+
+/**
+ * Struktura przechowująca odwzorowanie odtworzonego punktu kontrolnego.
+ * Wyzerowana struktura oznacza brak odwzorowania.
+ */
+typedef struct CheckpointImage {
+    void *map;   ///< odwzorowanie pliku lub NULL
+    size_t size; ///< rozmiar odwzorowania
+} CheckpointImage;
+
+/**
+ * Zapisuje punkt kontrolny stosu. Wielomiany na stosie są przy tym
+ * zamrażane. Plik jest zastępowany atomowo, więc można nadpisać plik,
+ * z którego stos został odtworzony.
+ * @param[in] st : stos zawierający tylko wielomiany
+ * @param[in] path : ścieżka pliku
+ * @return Czy udało się zapisać plik?
+ */
+bool writeCheckpoint(Stack *st, const char *path);
+
+/**
+ * Odtwarza stos z punktu kontrolnego, wkładając zapisane wielomiany
+ * na stos w zapisanej kolejności. Wielomiany są tylko do odczytu i są
+ * rozmrażane przy pierwszej zmianie. Odwzorowanie pliku musi istnieć,
+ * dopóki wielomiany są używane.
+ * @param[in] st : stos
+ * @param[in] path : ścieżka pliku
+ * @param[out] image : wyzerowana struktura na odwzorowanie pliku
+ * @return Czy udało się odtworzyć stos?
+ */
+bool restoreCheckpoint(Stack *st, const char *path, CheckpointImage *image);
+
+/**
+ * Usuwa odwzorowanie pliku odtworzonego punktu kontrolnego.
+ * Żaden wielomian z tego pliku nie może być już używany.
+ * @param[in] image : odwzorowanie pliku
+ */
+void releaseCheckpoint(CheckpointImage *image);
+
+#endif //_CHECKPOINT_H
@@ -6,275 +6,707 @@
 #include "stack.h"
 #include "poly_to_text.h"
 #include "poly_from_text.h"
+#include "poly_reclaim.h"
+#include "poly_trace.h"
+#include "monos.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
-#include <errno.h>
+#include <limits.h>
 
-char separators[] = " ";
-extern int errno;
+/** Najmniejsza liczba jednomianów wielomianu zamrażanego na stosie. */
+#define FREEZE_MIN_MONOS 64
+
+/** Najmniejsza liczba elementów z wierzchu stosu trzymanych zawsze w pamięci. */
+#define SPILL_MIN_DEPTH 3
+
+/** Najmniejsza liczba jednomianów wielomianu wyrzucanego do pliku. */
+#define SPILL_MIN_MONOS 64
 
 /**
- * Czyta i wykonuje podaną instrukcję z parametrem (DEG_BY lub AT).
- * @param[in] str : instrukcja
- * @param[in] st : stos, na którym operuje kalkulator
- * @param[in] line_nr : numer obecnie obsługiwanego wiersza
+ * Największy numer zmiennej instrukcji SWAP_VARS. Zamiana z dalszą zmienną
+ * tworzy wielomian o tak wielu poziomach zagnieżdżenia, że rekurencyjne
+ * operacje na nim przepełniłyby stos.
  */
-void takeInstrWithPar(char *str, Stack *st, long line_nr) {
-    char *token = strtok(str, separators);
-    char *after_number_char;
-    if (strcmp(token, "DEG_BY") == 0) {
-        char c = *(str + 7);
-        if (!isNumberStart(c)) {
-            fprintf(stderr, "ERROR %ld DEG BY WRONG VARIABLE\n", line_nr);
-            return;
-        }
-        char *str_par = str + 7;
+#define SWAP_VARS_MAX_VARIABLE 4095
 
-        errno = 0;
-        unsigned long par = strtoul(str_par, &after_number_char, 10);
-        if (after_number_char == str_par) {
-            fprintf(stderr, "ERROR %ld DEG BY WRONG VARIABLE\n", line_nr);
-            return;
-        }
+/** Znaki oddzielające nazwę instrukcji od parametru. */
+static const char separators[] = " ";
+
+/**
+ * Wczytuje element stosu wyrzucony do pliku i zapamiętuje jego użycie.
+ * @param[in] calc : kalkulator
+ * @param[in] i : pozycja elementu licząc od dna stosu
+ */
+static void loadSlot(Calculator *calc, size_t i) {
+    Stack *st = calc->stack;
+    Element *e = &st->elements[i];
+    if (e->type == SPILL) {
+        Poly p = PolySpillRead(&calc->spill.file, &e->s);
+        *e = elementOfPoly(&p);
+    }
+    if (calc->spill.depth == 0)
+        return;
+    if (i >= calc->spill.capacity) {
+        size_t capacity = calc->spill.capacity == 0 ? 16 : calc->spill.capacity;
+        while (capacity <= i)
+            capacity *= 2;
+        calc->spill.used = realloc(calc->spill.used, capacity * sizeof(unsigned long));
+        if (calc->spill.used == NULL)
+            exit(1);
+        memset(calc->spill.used + calc->spill.capacity, 0, (capacity - calc->spill.capacity) * sizeof(unsigned long));
+        calc->spill.capacity = capacity;
+    }
+    calc->spill.used[i] = calc->spill.clock;
+}
 
-        if (*str_par == '-' && par != 0) { //-0
-            fprintf(stderr, "ERROR %ld DEG BY WRONG VARIABLE\n", line_nr);
-            return;
+/**
+ * Oblicza leniwe wyrażenia i wczytuje wielomiany wyrzucone do pliku
+ * spośród @p k elementów z wierzchu stosu, zastępując je ich wartościami.
+ * @param[in] calc : kalkulator
+ * @param[in] k : liczba elementów
+ */
+static void forceTop(Calculator *calc, size_t k) {
+    Stack *st = calc->stack;
+    if (k > size(st))
+        k = size(st);
+    // obliczone wartości zastępują wyrażenia niezależnie od powodzenia
+    // instrukcji, więc nie mogą zostać przerwane po przekroczeniu budżetu
+    bool stop = MonosSetBudgetStop(false);
+    for (size_t i = size(st) - k; i < size(st); i++) {
+        loadSlot(calc, i);
+        Element *e = &st->elements[i];
+        if (e->type == EXPR) {
+            Poly p = PolyExprEval(e->x);
+            *e = elementOfPoly(&p);
         }
+    }
+    MonosSetBudgetStop(stop);
+}
+
+/**
+ * Daje wielomian leżący @p k pozycji pod wierzchem stosu, nie zdejmując go.
+ * @param[in] st : stos zawierający więcej niż @p k elementów
+ * @param[in] k : pozycja licząc od wierzchu
+ * @return wielomian
+ */
+static Poly peekPoly(Stack *st, size_t k) {
+    Element *e = &st->elements[size(st) - 1 - k];
+    assert(e->type == POLY);
+    return e->p;
+}
+
+/**
+ * Sprawdza, czy wykonanie instrukcji zmieściło się w budżecie pamięci.
+ * Jeśli nie, usuwa wynik instrukcji.
+ * @param[in] calc : kalkulator
+ * @param[in] p : wynik instrukcji
+ * @return Czy budżet nie został przekroczony?
+ */
+static bool withinBudget(Calculator *calc, Poly *p) {
+    if (!MonosOverBudgetSince(calc->mark))
+        return true;
+    PolyDestroy(p);
+    return false;
+}
+
+/**
+ * Zgłasza błąd instrukcji, której wynik usunięto w withinBudget: przerwanie
+ * po przekroczeniu limitu czasu albo brak pamięci.
+ * @param[in] calc : kalkulator
+ * @return kod błędu
+ */
+static int budgetError(Calculator *calc) {
+    return calcError(calc, MonosTimeExpired() ? CALC_TIME_LIMIT : CALC_OUT_OF_MEMORY);
+}
+
+/**
+ * Zdejmuje element z wierzchu stosu jako leniwe wyrażenie.
+ * @param[in] st : niepusty stos
+ * @return wyrażenie
+ */
+static PolyExpr *popExpr(Stack *st) {
+    Element *e = top(st);
+    PolyExpr *x = e->type == EXPR ? e->x : PolyExprLeaf(&e->p);
+    pop(st);
+    return x;
+}
+
+/**
+ * Czyta nieujemny parametr liczbowy instrukcji.
+ * Parametr musi być ostatnim elementem wiersza.
+ * @param[in] str_par : początek parametru
+ * @param[out] par : wartość parametru
+ * @return Czy parametr jest poprawny?
+ */
+static bool readUnsignedPar(char *str_par, unsigned long *par) {
+    char *after_number_char = str_par;
+    if (!readUnsignedLong(&after_number_char, par))
+        return false;
+    return strcmp(after_number_char, "\n") == 0 || strcmp(after_number_char, "") == 0;
+}
+
+/**
+ * Czyta dwa nieujemne parametry liczbowe instrukcji oddzielone spacją.
+ * Parametry muszą być ostatnimi elementami wiersza.
+ * @param[in] str_par : początek pierwszego parametru
+ * @param[out] a : wartość pierwszego parametru
+ * @param[out] b : wartość drugiego parametru
+ * @return Czy parametry są poprawne?
+ */
+static bool readTwoUnsignedPars(char *str_par, unsigned long *a, unsigned long *b) {
+    char *space = strchr(str_par, ' ');
+    if (space == NULL)
+        return false;
+    *space = '\0';
+    bool ok = readUnsignedPar(str_par, a) && readUnsignedPar(space + 1, b);
+    *space = ' ';
+    return ok;
+}
+
+/**
+ * Zastępuje @p k wielomianów z wierzchu stosu ich sumą lub iloczynem.
+ * @param[in] calc : kalkulator, którego stos zawiera co najmniej @p k wielomianów
+ * @param[in] k : liczba wielomianów
+ * @param[in] mul : czy liczyć iloczyn (wpp. sumę)
+ * @return CALC_OK lub kod błędu
+ */
+static int reduceTop(Calculator *calc, size_t k, bool mul) {
+    Stack *st = calc->stack;
+    forceTop(calc, k);
+    Poly *polys = malloc((k + 1) * sizeof(Poly));
+    if (polys == NULL)
+        exit(1);
+    Element *elements = &st->elements[size(st) - k];
+    for (size_t i = 0; i < k; i++) {
+        assert(elements[i].type == POLY);
+        polys[i] = elements[i].p;
+    }
+    Poly p = mul ? PolyMulMany(k, polys) : PolyAddMany(k, polys);
+    if (!withinBudget(calc, &p)) {
+        free(polys);
+        return budgetError(calc);
+    }
+    for (size_t i = 0; i < k; i++)
+        pop(st);
+    for (size_t i = 0; i < k; i++)
+        PolyReclaim(&polys[i]);
+    free(polys);
+    push(st, elementOfPoly(&p));
+    return CALC_OK;
+}
 
-        if (errno == ERANGE || (strcmp(after_number_char, "\n") != 0 && strcmp(after_number_char, "") != 0)) {
-            fprintf(stderr, "ERROR %ld DEG BY WRONG VARIABLE\n", line_nr);
-            return;
+/**
+ * Czyta i wykonuje podaną instrukcję z parametrem (DEG_BY, AT, ADD_N, MUL_N,
+ * MUL_TRUNC, SWAP_VARS lub CHECKPOINT).
+ * @param[in] calc : kalkulator
+ * @param[in] str : instrukcja
+ * @return CALC_OK lub kod błędu
+ */
+static int takeInstrWithPar(Calculator *calc, char *str) {
+    Stack *st = calc->stack;
+    // nazwę instrukcji oddzielamy od parametru jak strtok, ale bez jego
+    // ukrytego stanu
+    char *token = str;
+    str[strcspn(str, separators)] = '\0';
+    if (strcmp(token, "DEG_BY") == 0) {
+        unsigned long par;
+        if (!readUnsignedPar(str + 7, &par)) {
+            return calcError(calc, CALC_DEG_BY_WRONG_VARIABLE);
         }
 
         if (isEmpty(st)) {
-            fprintf(stderr, "ERROR %ld STACK UNDERFLOW\n", line_nr);
-            return;
+            return calcError(calc, CALC_STACK_UNDERFLOW);
         }
+        forceTop(calc, 1);
         Element * e = top(st);
         assert (e->type == POLY);
         Poly p = e->p;
         long deg = PolyDegBy(&p, par);
-        printf("%ld\n", deg);
-        return;
+        fprintf(calc->out, "%ld\n", deg);
+        return CALC_OK;
     }
-    if (strcmp(str, "AT") == 0) {
-        char c = *(str + 3);
-        if (!isNumberStart(c)) {
-            fprintf(stderr, "ERROR %ld AT WRONG VALUE\n", line_nr);
-            return;
+    if (strcmp(token, "ADD_N") == 0 || strcmp(token, "MUL_N") == 0) {
+        bool mul = strcmp(token, "MUL_N") == 0;
+        unsigned long k;
+        if (!readUnsignedPar(str + 6, &k) || k == 0) {
+            return calcError(calc, mul ? CALC_MUL_N_WRONG_COUNT : CALC_ADD_N_WRONG_COUNT);
         }
-
-        char *str_par = str + 3;
-        errno = 0;
-        long par = strtol(str_par, &after_number_char, 10);
-        if (after_number_char == str_par) {
-            fprintf(stderr, "ERROR %ld AT WRONG VALUE\n", line_nr);
-            return;
+        if (size(st) < k) {
+            return calcError(calc, CALC_STACK_UNDERFLOW);
+        }
+        return reduceTop(calc, k, mul);
+    }
+    if (strcmp(token, "MUL_TRUNC") == 0) {
+        unsigned long par;
+        if (!readUnsignedPar(str + 10, &par)) {
+            return calcError(calc, CALC_MUL_TRUNC_WRONG_DEGREE);
+        }
+        if (size(st) < 2) {
+            return calcError(calc, CALC_STACK_UNDERFLOW);
+        }
+        poly_exp_t deg = par > INT_MAX ? INT_MAX : (poly_exp_t)par;
+        forceTop(calc, 2);
+        Poly p1 = peekPoly(st, 0);
+        Poly p2 = peekPoly(st, 1);
+        Poly p = PolyMulTrunc(&p1, &p2, deg);
+        if (!withinBudget(calc, &p))
+            return budgetError(calc);
+        pop(st);
+        pop(st);
+        PolyReclaim(&p1);
+        PolyReclaim(&p2);
+        push(st, elementOfPoly(&p));
+        return CALC_OK;
+    }
+    if (strcmp(token, "CHECKPOINT") == 0) {
+        char *path = str + 11;
+        path[strcspn(path, "\n")] = '\0';
+        if (*path == '\0' || !calc->checkpoints) {
+            return calcError(calc, CALC_CHECKPOINT_FAILED);
+        }
+        forceTop(calc, size(st));
+        if (!writeCheckpoint(st, path))
+            return calcError(calc, CALC_CHECKPOINT_FAILED);
+        return CALC_OK;
+    }
+    if (strcmp(token, "SWAP_VARS") == 0) {
+        unsigned long i, j;
+        if (!readTwoUnsignedPars(str + 10, &i, &j)
+            || i > SWAP_VARS_MAX_VARIABLE || j > SWAP_VARS_MAX_VARIABLE) {
+            return calcError(calc, CALC_SWAP_VARS_WRONG_VARIABLE);
+        }
+        if (isEmpty(st)) {
+            return calcError(calc, CALC_STACK_UNDERFLOW);
+        }
+        forceTop(calc, 1);
+        Poly p = top(st)->p;
+        Poly q = PolySwapVars(&p, i, j);
+        if (!withinBudget(calc, &q))
+            return budgetError(calc);
+        pop(st);
+        PolyReclaim(&p);
+        push(st, elementOfPoly(&q));
+        return CALC_OK;
+    }
+    if (strcmp(str, "AT") == 0) {
+        char *after_number_char = str + 3;
+        long par;
+        if (!readLong(&after_number_char, &par)) {
+            return calcError(calc, CALC_AT_WRONG_VALUE);
         }
 
-        if (errno == ERANGE || (strcmp(after_number_char, "\n") != 0 && strcmp(after_number_char, "") != 0)) {
-            fprintf(stderr, "ERROR %ld AT WRONG VALUE\n", line_nr);
-            return;
+        if (strcmp(after_number_char, "\n") != 0 && strcmp(after_number_char, "") != 0) {
+            return calcError(calc, CALC_AT_WRONG_VALUE);
         }
         if (isEmpty(st)) {
-            fprintf(stderr, "ERROR %ld STACK UNDERFLOW\n", line_nr);
-            return;
+            return calcError(calc, CALC_STACK_UNDERFLOW);
         }
+        forceTop(calc, 1);
         Element * e = top(st);
         assert (e->type == POLY);
         Poly p = e->p;
-        Poly q = PolyAt(&p, par);
+        Poly q = PolyCacheApply(&calc->cache, CACHE_AT, &p, NULL, par);
+        if (!withinBudget(calc, &q))
+            return budgetError(calc);
         pop(st);
-        PolyDestroy(&p);
+        PolyReclaim(&p);
         push(st, elementOfPoly(&q));
-        return;
+        return CALC_OK;
     }
     else {
-        fprintf(stderr, "ERROR %ld WRONG COMMAND\n", line_nr);
+        return calcError(calc, CALC_WRONG_COMMAND);
     }
 }
 
-
-void takeInstruction(char *str, Stack *st, long line_nr) {
+/**
+ * Czyta i wykonuje podaną instrukcję (bez śledzenia).
+ * @param[in] calc : kalkulator
+ * @param[in] str : instrukcja
+ * @return CALC_OK lub kod błędu
+ */
+static int executeInstruction(Calculator *calc, char *str) {
+    Stack *st = calc->stack;
     if (strcmp(str, "ZERO\n") == 0 || strcmp(str, "ZERO") == 0) {
         Poly p = PolyZero();
         Element e = elementOfPoly(&p);
         push(st, e);
-        return;
+        return CALC_OK;
     }
     if (strcmp(str, "IS_COEFF\n") == 0 || strcmp(str, "IS_COEFF") == 0) {
         if (isEmpty(st)) {
-            fprintf(stderr, "ERROR %ld STACK UNDERFLOW\n", line_nr);
-            return;
+            return calcError(calc, CALC_STACK_UNDERFLOW);
         }
+        forceTop(calc, 1);
         Element * e = top(st);
         assert (e->type == POLY);
         Poly p = e->p;
         bool b = PolyIsCoeff(&p);
-        printf("%d\n", b);
-        return;
+        fprintf(calc->out, "%d\n", b);
+        return CALC_OK;
     }
     if (strcmp(str, "IS_ZERO\n") == 0 || strcmp(str, "IS_ZERO") == 0) {
         if (isEmpty(st)) {
-            fprintf(stderr, "ERROR %ld STACK UNDERFLOW\n", line_nr);
-            return;
+            return calcError(calc, CALC_STACK_UNDERFLOW);
         }
+        forceTop(calc, 1);
         Element * e = top(st);
         assert (e->type == POLY);
         Poly p = e->p;
         bool b = PolyIsZero(&p);
-        printf("%d\n", b);
-        return;
+        fprintf(calc->out, "%d\n", b);
+        return CALC_OK;
     }
     if (strcmp(str, "CLONE\n") == 0 || strcmp(str, "CLONE") == 0) {
         if (isEmpty(st)) {
-            fprintf(stderr, "ERROR %ld STACK UNDERFLOW\n", line_nr);
-            return;
+            return calcError(calc, CALC_STACK_UNDERFLOW);
         }
         Element * e = top(st);
+        if (e->type == EXPR) {
+            push(st, elementOfExpr(PolyExprRetain(e->x)));
+            return CALC_OK;
+        }
         assert (e->type == POLY);
         Poly p = e->p;
         Poly q = PolyClone(&p);
+        if (!withinBudget(calc, &q))
+            return budgetError(calc);
         Element e2 = elementOfPoly(&q);
         push(st, e2);
-        return;
+        return CALC_OK;
     }
     if (strcmp(str, "ADD\n") == 0 || strcmp(str, "ADD") == 0) {
         if (size(st) < 2) {
-            fprintf(stderr, "ERROR %ld STACK UNDERFLOW\n", line_nr);
-            return;
+            return calcError(calc, CALC_STACK_UNDERFLOW);
         }
-        Element *e1 = top(st);
-        Poly p1 = e1->p;
-        pop(st);
-        if (isEmpty(st)) {
-            fprintf(stderr, "ERROR %ld STACK UNDERFLOW\n", line_nr);
-            return;
+        if (calc->lazy) {
+            PolyExpr *x1 = popExpr(st);
+            PolyExpr *x2 = popExpr(st);
+            push(st, elementOfExpr(PolyExprAdd(x1, x2)));
+            return CALC_OK;
         }
-        e1 = top(st);
-        Poly p2 = e1->p;
+        Poly p1 = peekPoly(st, 0);
+        Poly p2 = peekPoly(st, 1);
+        Poly p = PolyCacheApply(&calc->cache, CACHE_ADD, &p1, &p2, 0);
+        if (!withinBudget(calc, &p))
+            return budgetError(calc);
+        pop(st);
         pop(st);
-        Poly p = PolyAdd(&p1, &p2);
-        PolyDestroy(&p1);
-        PolyDestroy(&p2);
+        PolyReclaim(&p1);
+        PolyReclaim(&p2);
         push(st, elementOfPoly(&p));
-        return;
+        return CALC_OK;
     }
     if (strcmp(str, "MUL\n") == 0 || strcmp(str, "MUL") == 0) {
         if (size(st) < 2) {
-            fprintf(stderr, "ERROR %ld STACK UNDERFLOW\n", line_nr);
-            return;
+            return calcError(calc, CALC_STACK_UNDERFLOW);
         }
-        Element *e1 = top(st);
-        Poly p1 = e1->p;
+        if (calc->lazy) {
+            PolyExpr *x1 = popExpr(st);
+            PolyExpr *x2 = popExpr(st);
+            push(st, elementOfExpr(PolyExprMul(x1, x2)));
+            return CALC_OK;
+        }
+        Poly p1 = peekPoly(st, 0);
+        Poly p2 = peekPoly(st, 1);
+        Poly p = PolyCacheApply(&calc->cache, CACHE_MUL, &p1, &p2, 0);
+        if (!withinBudget(calc, &p))
+            return budgetError(calc);
         pop(st);
-        if (isEmpty(st)) {
-            fprintf(stderr, "ERROR %ld STACK UNDERFLOW\n", line_nr);
-            return;
+        pop(st);
+        PolyReclaim(&p1);
+        PolyReclaim(&p2);
+        push(st, elementOfPoly(&p));
+        return CALC_OK;
+    }
+    if (strcmp(str, "MULADD\n") == 0 || strcmp(str, "MULADD") == 0) {
+        if (size(st) < 3) {
+            return calcError(calc, CALC_STACK_UNDERFLOW);
+        }
+        if (calc->lazy) {
+            PolyExpr *x1 = popExpr(st);
+            PolyExpr *x2 = popExpr(st);
+            PolyExpr *x3 = popExpr(st);
+            push(st, elementOfExpr(PolyExprAdd(PolyExprMul(x1, x2), x3)));
+            return CALC_OK;
+        }
+        Poly p1 = peekPoly(st, 0);
+        Poly p2 = peekPoly(st, 1);
+        Poly p3 = peekPoly(st, 2);
+        // wynik PolyMulAdd przerwanego po przekroczeniu budżetu lub limitu
+        // czasu byłby niepełny, a trzeci argument - już zmieniony
+        if (!MonosBudgetLimited()) {
+            pop(st);
+            pop(st);
+            pop(st);
+            PolyMulAdd(&p1, &p2, &p3);
+            PolyReclaim(&p1);
+            PolyReclaim(&p2);
+            push(st, elementOfPoly(&p3));
+            return CALC_OK;
         }
-        e1 = top(st);
-        Poly p2 = e1->p;
+        // przy budżecie iloczyn i suma są liczone osobno, żeby po jego
+        // przekroczeniu (albo upływie limitu czasu) trzeci argument pozostał
+        // na stosie nienaruszony
+        Poly q = PolyMul(&p1, &p2);
+        if (!withinBudget(calc, &q))
+            return budgetError(calc);
+        Poly p = PolyAdd(&q, &p3);
+        PolyDestroy(&q);
+        if (!withinBudget(calc, &p))
+            return budgetError(calc);
         pop(st);
-        Poly p = PolyMul(&p1, &p2);
-        PolyDestroy(&p1);
-        PolyDestroy(&p2);
+        pop(st);
+        pop(st);
+        PolyReclaim(&p1);
+        PolyReclaim(&p2);
+        PolyReclaim(&p3);
         push(st, elementOfPoly(&p));
-        return;
+        return CALC_OK;
     }
     if (strcmp(str, "NEG\n") == 0 || strcmp(str, "NEG") == 0) {
         if (isEmpty(st)) {
-            fprintf(stderr, "ERROR %ld STACK UNDERFLOW\n", line_nr);
-            return;
+            return calcError(calc, CALC_STACK_UNDERFLOW);
+        }
+        if (calc->lazy) {
+            push(st, elementOfExpr(PolyExprNeg(popExpr(st))));
+            return CALC_OK;
         }
         Element * e = top(st);
         assert (e->type == POLY);
         Poly p = e->p;
         Poly q = PolyNeg(&p);
-        PolyDestroy(&p);
+        if (!withinBudget(calc, &q))
+            return budgetError(calc);
+        PolyReclaim(&p);
         pop(st);
         push(st, elementOfPoly(&q));
-        return;
+        return CALC_OK;
     }
     if (strcmp(str, "SUB\n") == 0 || strcmp(str, "SUB") == 0) {
         if (size(st) < 2) {
-            fprintf(stderr, "ERROR %ld STACK UNDERFLOW\n", line_nr);
-            return;
+            return calcError(calc, CALC_STACK_UNDERFLOW);
         }
-        Element *e1 = top(st);
-        Poly p1 = e1->p;
-        pop(st);
-        if (isEmpty(st)) {
-            fprintf(stderr, "ERROR %ld STACK UNDERFLOW\n", line_nr);
-            return;
+        if (calc->lazy) {
+            PolyExpr *x1 = popExpr(st);
+            PolyExpr *x2 = popExpr(st);
+            push(st, elementOfExpr(PolyExprSub(x1, x2)));
+            return CALC_OK;
         }
-        e1 = top(st);
-        Poly p2 = e1->p;
-        pop(st);
+        Poly p1 = peekPoly(st, 0);
+        Poly p2 = peekPoly(st, 1);
         Poly p = PolySub(&p1, &p2);
-        PolyDestroy(&p1);
-        PolyDestroy(&p2);
+        if (!withinBudget(calc, &p))
+            return budgetError(calc);
+        pop(st);
+        pop(st);
+        PolyReclaim(&p1);
+        PolyReclaim(&p2);
         push(st, elementOfPoly(&p));
-        return;
+        return CALC_OK;
     }
     if (strcmp(str, "IS_EQ\n") == 0 || strcmp(str, "IS_EQ") == 0) {
         if (size(st) < 2) {
-            fprintf(stderr, "ERROR %ld STACK UNDERFLOW\n", line_nr);
-            return;
+            return calcError(calc, CALC_STACK_UNDERFLOW);
         }
+        forceTop(calc, 2);
         Element *e1 = top(st);
         assert(e1->type == POLY);
         Poly p1 = e1->p;
         pop(st);
         if (isEmpty(st)) {
-            fprintf(stderr, "ERROR %ld STACK UNDERFLOW\n", line_nr);
-            return;
+            return calcError(calc, CALC_STACK_UNDERFLOW);
         }
         Element *e2 = top(st);
         Poly p2 = e2->p;
         assert(e2->type == POLY);
         bool b = PolyIsEq(&p1, &p2);
-        printf("%d\n", b);
+        fprintf(calc->out, "%d\n", b);
         push(st, elementOfPoly(&p1));
-        return;
+        return CALC_OK;
     }
     if (strcmp(str, "DEG\n") == 0 || strcmp(str, "DEG") == 0) {
         if (isEmpty(st)) {
-            fprintf(stderr, "ERROR %ld STACK UNDERFLOW\n", line_nr);
-            return;
+            return calcError(calc, CALC_STACK_UNDERFLOW);
         }
+        forceTop(calc, 1);
         Element * e = top(st);
         assert (e->type == POLY);
         Poly p = e->p;
         long deg = PolyDeg(&p);
-        printf("%ld\n", deg);
-        return;
+        fprintf(calc->out, "%ld\n", deg);
+        return CALC_OK;
     }
     if (strcmp(str, "PRINT\n") == 0 || strcmp(str, "PRINT") == 0) {
         if (isEmpty(st)) {
-            fprintf(stderr, "ERROR %ld STACK UNDERFLOW\n", line_nr);
-            return;
+            return calcError(calc, CALC_STACK_UNDERFLOW);
         }
+        forceTop(calc, 1);
         Element * e = top(st);
         assert (e->type == POLY);
         Poly p = e->p;
-        printPoly(&p);
-        printf("\n");
-        return;
+        printPoly(calc->out, &p);
+        fprintf(calc->out, "\n");
+        return CALC_OK;
     }
     if (strcmp(str, "POP\n") == 0 || strcmp(str, "POP") == 0) {
         if (isEmpty(st)) {
-            fprintf(stderr, "ERROR %ld STACK UNDERFLOW\n", line_nr);
-            return;
+            return calcError(calc, CALC_STACK_UNDERFLOW);
         }
         Element * e = top(st);
-        assert (e->type == POLY);
-        Poly p = e->p;
-        PolyDestroy(&p);
+        if (e->type == EXPR)
+            PolyExprRelease(e->x);
+        else
+            PolyReclaim(&e->p);
         pop(st);
+        return CALC_OK;
+    }
+    if (strcmp(str, "ADD_ALL\n") == 0 || strcmp(str, "ADD_ALL") == 0
+        || strcmp(str, "MUL_ALL\n") == 0 || strcmp(str, "MUL_ALL") == 0) {
+        if (isEmpty(st)) {
+            return calcError(calc, CALC_STACK_UNDERFLOW);
+        }
+        return reduceTop(calc, size(st), str[0] == 'M');
+    }
+    if (strcmp(str, "MEM\n") == 0 || strcmp(str, "MEM") == 0) {
+        fprintf(calc->out, "%zu %zu %zu\n", size(st), MonosLiveBytes(), MonosGetBudget());
+        for (size_t i = size(st); i-- > 0;) {
+            Element *e = &st->elements[i];
+            if (e->type == EXPR)
+                fprintf(calc->out, "0 0\n");
+            else if (e->type == SPILL)
+                fprintf(calc->out, "%zu 0\n", e->s.monos);
+            else
+                fprintf(calc->out, "%zu %zu\n", MonosOfPoly(&e->p), MonosBytesOfPoly(&e->p));
+        }
+        return CALC_OK;
+    }
+    if (strcmp(str, "CACHE_STATS\n") == 0 || strcmp(str, "CACHE_STATS") == 0) {
+        PolyCacheStats stats = PolyCacheGetStats(&calc->cache);
+        fprintf(calc->out, "%lu %lu %zu %zu\n", stats.hits, stats.misses, stats.entries, stats.bytes);
+        return CALC_OK;
+    }
+    return takeInstrWithPar(calc, str);
+}
+
+/**
+ * Daje liczbę jednomianów elementu stosu leżącego @p k pozycji pod
+ * wierzchem (0 dla brakującego elementu lub leniwego wyrażenia).
+ * @param[in] st : stos
+ * @param[in] k : pozycja licząc od wierzchu
+ * @return liczba jednomianów
+ */
+static size_t traceOperandSize(Stack *st, size_t k) {
+    if (k >= size(st))
+        return 0;
+    Element *e = &st->elements[size(st) - 1 - k];
+    return e->type == POLY ? MonosOfPoly(&e->p) : 0;
+}
+
+/**
+ * Zamraża wielomian leżący bezpośrednio pod wierzchem stosu. Taki
+ * wielomian zwykle długo pozostaje na stosie i jest tylko czytany.
+ * @param[in] calc : kalkulator
+ */
+static void freezeBelowTop(Calculator *calc) {
+    Stack *st = calc->stack;
+    if (!calc->freeze || size(st) < 2)
+        return;
+    Element *e = &st->elements[size(st) - 2];
+    if (e->type == POLY && MonosOfPoly(&e->p) >= FREEZE_MIN_MONOS)
+        PolyFreeze(&e->p);
+}
+
+/**
+ * Struktura opisująca pozycję stosu, którą można wyrzucić do pliku.
+ */
+typedef struct ColdSlot {
+    unsigned long used; ///< chwila ostatniego użycia
+    size_t i;           ///< pozycja licząc od dna stosu
+} ColdSlot;
+
+/**
+ * Porównuje pozycje stosu według chwil ich ostatniego użycia.
+ * @param[in] a : wskaźnik na pozycję
+ * @param[in] b : wskaźnik na pozycję
+ * @return wynik porównania jak w qsort
+ */
+static int compareUsed(const void *a, const void *b) {
+    unsigned long ua = ((const ColdSlot *)a)->used;
+    unsigned long ub = ((const ColdSlot *)b)->used;
+    return (ua > ub) - (ua < ub);
+}
+
+/**
+ * Wczytuje elementy z wierzchu stosu, a jeśli wielomiany zajmują więcej
+ * pamięci niż docelowo, wyrzuca do pliku najdawniej używane wielomiany
+ * leżące głębiej.
+ * @param[in] calc : kalkulator
+ */
+static void spillCold(Calculator *calc) {
+    Stack *st = calc->stack;
+    if (calc->spill.depth == 0)
+        return;
+    calc->spill.clock++;
+    size_t n = size(st);
+    size_t hot = n < calc->spill.depth ? 0 : n - calc->spill.depth;
+    for (size_t i = hot; i < n; i++)
+        loadSlot(calc, i);
+    if (MonosLiveBytes() <= calc->spill.target)
         return;
+
+    ColdSlot *cold = malloc((hot + 1) * sizeof(ColdSlot));
+    if (cold == NULL)
+        exit(1);
+    size_t count = 0;
+    for (size_t i = 0; i < hot; i++) {
+        Element *e = &st->elements[i];
+        if (e->type == POLY && !PolyIsCoeff(&e->p) && MonosOfPoly(&e->p) >= SPILL_MIN_MONOS)
+            cold[count++] = (ColdSlot) {.used = calc->spill.used[i], .i = i};
+    }
+    qsort(cold, count, sizeof(ColdSlot), compareUsed);
+    for (size_t j = 0; j < count && MonosLiveBytes() > calc->spill.target; j++) {
+        Element *e = &st->elements[cold[j].i];
+        SpillRecord r;
+        if (!PolySpillWrite(&calc->spill.file, &e->p, &r))
+            break;
+        *e = elementOfSpill(&r);
     }
-    takeInstrWithPar(str, st, line_nr);
+    free(cold);
+}
+
+void maintainStack(Calculator *calc) {
+    freezeBelowTop(calc);
+    spillCold(calc);
+}
+
+/**
+ * Wykonuje instrukcję, zapisując zdarzenie śledzenia.
+ * @param[in] calc : kalkulator
+ * @param[in] str : instrukcja
+ * @param[in] start : chwila rozpoczęcia zdarzenia
+ * @return CALC_OK lub kod błędu
+ */
+static int executeTraced(Calculator *calc, char *str, uint64_t start) {
+    // wykonanie zmienia instrukcję, więc jej nazwę kopiujemy wcześniej
+    char name[TRACE_NAME_LENGTH + 1];
+    size_t n = strcspn(str, " \n");
+    if (n > TRACE_NAME_LENGTH)
+        n = TRACE_NAME_LENGTH;
+    memcpy(name, str, n);
+    name[n] = 0;
+    size_t a = traceOperandSize(calc->stack, 0);
+    size_t b = traceOperandSize(calc->stack, 1);
+    int res = executeInstruction(calc, str);
+    TraceEnd(name, start, a, b);
+    return res;
+}
+
+int takeInstruction(Calculator *calc, char *str) {
+    calc->mark = MonosBudgetMark();
+    uint64_t start = TraceBegin();
+    int res = start == 0 ? executeInstruction(calc, str) : executeTraced(calc, str, start);
+    maintainStack(calc);
+    return res;
 }
\ No newline at end of file
@@ -4,14 +4,28 @@
 
 #ifndef _INSTRUCTIONS_READER_H
 #define _INSTRUCTIONS_READER_H
-#include "stack.h"
+#include "calculator.h"
+
+/**
+ * Porządkuje stos po obsłużeniu wiersza: zamraża wielomian leżący pod
+ * wierzchem (jeśli włączono zamrażanie) i wyrzuca do pliku zimne
+ * elementy (jeśli włączono wyrzucanie).
+ * @param[in] calc : kalkulator
+ */
+void maintainStack(Calculator *calc);
 
 /**
  * Czyta i wykonuje podaną instrukcję.
- * @param[in] str : instrukcja
- * @param[in] st : stos, na którym operuje kalkulator
- * @param[in] line_nr : numer obecnie obsługiwanego wiersza
+ * Instrukcja, której wykonanie przekroczyło budżet pamięci, kończy się
+ * błędem i pozostawia stos bez zmian. Instrukcja MEM wypisuje liczbę
+ * elementów stosu, liczbę bajtów zajmowanych przez wszystkie wielomiany
+ * i budżet pamięci, a następnie, od wierzchu stosu, liczbę jednomianów
+ * i bajtów każdego elementu (0 0 dla nieobliczonego wyrażenia, 0 bajtów
+ * dla wielomianu wyrzuconego do pliku).
+ * @param[in] calc : kalkulator
+ * @param[in] str : instrukcja (jest przy tym zmieniana)
+ * @return CALC_OK lub kod błędu
  */
-void takeInstruction(char *str, Stack *st, long line_nr);
+int takeInstruction(Calculator *calc, char *str);
 
 #endif //_INSTRUCTIONS_READER_H
@@ -0,0 +1,357 @@
+/** @file
+  Implementacja zarządzania pamięcią tablic jednomianów.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <time.h>
+#include <string.h>
+#include <assert.h>
+#include <stdatomic.h>
+#include "monos.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/** Liczba klas rozmiarów bloków przechowywanych w puli. */
+#define POOL_CLASSES 2
+
+/** Maksymalna liczba bloków jednej klasy przechowywanych w puli wątku. */
+#define POOL_MAX_BLOCKS 4096
+
+/**
+ * Struktura przechowująca wolny blok w puli.
+ */
+typedef struct FreeBlock {
+    struct FreeBlock *next; ///< następny wolny blok
+} FreeBlock;
+
+/** Listy wolnych bloków każdej z klas. */
+static _Thread_local FreeBlock *free_blocks[POOL_CLASSES];
+
+/** Liczby wolnych bloków w każdej z klas. */
+static _Thread_local size_t free_count[POOL_CLASSES];
+
+/** Budżet przydziałów wykonywanych poza kalkulatorami. */
+static MonosBudget process_budget;
+
+/** Kontekst przydziałów bieżącego wątku. */
+static _Thread_local MonosContext context = {.budget = NULL, .stop = true};
+
+/**
+ * Daje budżet bieżącego wątku.
+ * @return budżet
+ */
+static MonosBudget *currentBudget(void) {
+    return context.budget != NULL ? context.budget : &process_budget;
+}
+
+/**
+ * Dolicza przydzielony blok do zajmowanej pamięci.
+ * @param[in] bytes : rozmiar bloku
+ */
+static void countAlloc(size_t bytes) {
+    MonosBudget *b = currentBudget();
+    size_t live = atomic_fetch_add_explicit(&b->live, bytes, memory_order_relaxed) + bytes;
+    size_t limit = atomic_load_explicit(&b->limit, memory_order_relaxed);
+    if (limit != 0 && live > limit)
+        atomic_fetch_add_explicit(&b->overflows, 1, memory_order_relaxed);
+}
+
+/**
+ * Odlicza zwolniony blok od zajmowanej pamięci.
+ * @param[in] bytes : rozmiar bloku
+ */
+static void countFree(size_t bytes) {
+    atomic_fetch_sub_explicit(&currentBudget()->live, bytes, memory_order_relaxed);
+}
+
+/**
+ * Daje klasę bloku o podanej pojemności.
+ * @param[in] capacity : pojemność, nie większa niż MONOS_SMALL_CAPACITY
+ * @return numer klasy
+ */
+static int poolClass(size_t capacity) {
+    assert(capacity <= MONOS_SMALL_CAPACITY);
+    return capacity <= MONOS_SMALL_CAPACITY / 2 ? 0 : 1;
+}
+
+/**
+ * Daje pojemność bloków danej klasy.
+ * @param[in] cls : numer klasy
+ * @return pojemność bloku
+ */
+static size_t classCapacity(int cls) {
+    return cls == 0 ? MONOS_SMALL_CAPACITY / 2 : MONOS_SMALL_CAPACITY;
+}
+
+size_t MonosBlockSize(size_t capacity) {
+    return sizeof(MonosHeader) + capacity * (sizeof(Mono) + sizeof(poly_exp_t));
+}
+
+size_t MonosCountAbove(const poly_exp_t *exps, size_t n, poly_exp_t bound) {
+    size_t i = 0;
+    // serie są zwykle krótkie, więc najpierw sprawdzamy pojedyncze wykładniki
+    while (i < n && i < 4) {
+        if (exps[i] <= bound)
+            return i;
+        i++;
+    }
+#ifdef __SSE2__
+    __m128i b = _mm_set1_epi32(bound);
+    while (i + 4 <= n) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(exps + i));
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(v, b)));
+        if (mask != 0xF)
+            return i + __builtin_ctz(~mask);
+        i += 4;
+    }
+#endif
+    while (i < n && exps[i] > bound)
+        i++;
+    return i;
+}
+
+Mono *MonosAlloc(size_t capacity) {
+    MonosHeader *h;
+    if (capacity <= MONOS_SMALL_CAPACITY) {
+        int cls = poolClass(capacity);
+        capacity = classCapacity(cls);
+        if (free_blocks[cls] != NULL) {
+            FreeBlock *b = free_blocks[cls];
+            free_blocks[cls] = b->next;
+            free_count[cls]--;
+            h = (MonosHeader *)b;
+        }
+        else {
+            h = malloc(MonosBlockSize(capacity));
+        }
+    }
+    else {
+        h = malloc(MonosBlockSize(capacity));
+    }
+    if (h == NULL)
+        exit(1);
+    h->capacity = capacity;
+    h->frozen = false;
+    h->mapped = false;
+    countAlloc(MonosBlockSize(capacity));
+    return (Mono *)(h + 1);
+}
+
+Mono *MonosResize(Mono *arr, size_t capacity) {
+    assert(!MonosIsFrozen(arr));
+    size_t old_capacity = MonosCapacity(arr);
+    if (old_capacity <= MONOS_SMALL_CAPACITY || capacity <= MONOS_SMALL_CAPACITY) {
+        if (capacity <= old_capacity && old_capacity <= MONOS_SMALL_CAPACITY)
+            return arr;
+        Mono *res = MonosAlloc(capacity);
+        size_t n = capacity < old_capacity ? capacity : old_capacity;
+        memcpy(res, arr, n * sizeof(Mono));
+        MonosFree(arr);
+        return res;
+    }
+    MonosHeader *h = realloc(MonosGetHeader(arr), MonosBlockSize(capacity));
+    if (h == NULL)
+        exit(1);
+    countFree(MonosBlockSize(old_capacity));
+    countAlloc(MonosBlockSize(capacity));
+    h->capacity = capacity;
+    return (Mono *)(h + 1);
+}
+
+void MonosFree(Mono *arr) {
+    if (arr == NULL)
+        return;
+    MonosHeader *h = MonosGetHeader(arr);
+    assert(!h->frozen);
+    countFree(MonosBlockSize(h->capacity));
+    if (h->capacity <= MONOS_SMALL_CAPACITY) {
+        int cls = poolClass(h->capacity);
+        if (free_count[cls] < POOL_MAX_BLOCKS) {
+            FreeBlock *b = (FreeBlock *)h;
+            b->next = free_blocks[cls];
+            free_blocks[cls] = b;
+            free_count[cls]++;
+            return;
+        }
+    }
+    free(h);
+}
+
+void *MonosAllocFrozen(size_t bytes) {
+    void *block = malloc(bytes);
+    if (block == NULL)
+        exit(1);
+    countAlloc(bytes);
+    return block;
+}
+
+void MonosFreeFrozen(Mono *arr) {
+    MonosHeader *h = MonosGetHeader(arr);
+    assert(h->frozen);
+    if (h->mapped)
+        return;
+    countFree(h->bytes);
+    free(h);
+}
+
+void MonosRelocateFrozen(char *block, size_t bytes, uintptr_t delta, bool mapped) {
+    for (size_t off = 0; off < bytes;) {
+        MonosHeader *h = (MonosHeader *)(block + off);
+        Mono *arr = (Mono *)(h + 1);
+        for (size_t i = 0; i < h->capacity; i++) {
+            if (arr[i].p.arr != NULL)
+                arr[i].p.arr = (Mono *)((uintptr_t)arr[i].p.arr + delta);
+        }
+        h->mapped = mapped;
+        off += MonosFrozenSize(h->capacity);
+    }
+}
+
+void MonosPoolRelease(void) {
+    for (int cls = 0; cls < POOL_CLASSES; cls++) {
+        while (free_blocks[cls] != NULL) {
+            FreeBlock *b = free_blocks[cls];
+            free_blocks[cls] = b->next;
+            free(b);
+        }
+        free_count[cls] = 0;
+    }
+}
+
+void MonosBudgetInit(MonosBudget *budget, size_t bytes) {
+    atomic_init(&budget->live, 0);
+    atomic_init(&budget->limit, bytes);
+    atomic_init(&budget->overflows, 0);
+    budget->deadline = 0;
+    atomic_init(&budget->charged, 0);
+    atomic_init(&budget->expired, false);
+}
+
+MonosBudget *MonosUseBudget(MonosBudget *budget) {
+    MonosBudget *old = context.budget;
+    context.budget = budget;
+    return old;
+}
+
+MonosContext MonosGetContext(void) {
+    return context;
+}
+
+MonosContext MonosSetContext(MonosContext ctx) {
+    MonosContext old = context;
+    context = ctx;
+    return old;
+}
+
+void MonosSetBudget(size_t bytes) {
+    atomic_store_explicit(&currentBudget()->limit, bytes, memory_order_relaxed);
+}
+
+size_t MonosGetBudget(void) {
+    return atomic_load_explicit(&currentBudget()->limit, memory_order_relaxed);
+}
+
+size_t MonosLiveBytes(void) {
+    return atomic_load_explicit(&currentBudget()->live, memory_order_relaxed);
+}
+
+/**
+ * Daje czas procesora zużyty przez wątek.
+ * @param[in] thread : wątek
+ * @return czas w nanosekundach lub 0, jeśli nie udało się go odczytać
+ */
+static uint64_t threadCpuTime(pthread_t thread) {
+    clockid_t clock;
+    struct timespec ts;
+    if (pthread_getcpuclockid(thread, &clock) != 0 || clock_gettime(clock, &ts) != 0)
+        return 0;
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+void MonosSetTimeLimit(double seconds) {
+    MonosBudget *b = currentBudget();
+    b->owner = pthread_self();
+    b->deadline = seconds > 0 ? threadCpuTime(b->owner) + (uint64_t)(seconds * 1e9) + 1 : 0;
+    atomic_store(&b->charged, 0);
+    atomic_store(&b->expired, false);
+}
+
+double MonosChargedTime(void) {
+    return atomic_load(&currentBudget()->charged) / 1e9;
+}
+
+/**
+ * Czy bieżący wątek mierzy już czas zadania? Zadania zagnieżdżone w
+ * mierzonym zadaniu (wykonywane przy czekaniu na jego grupy) należą do tego
+ * samego budżetu i nie są liczone drugi raz.
+ */
+static _Thread_local bool charging;
+
+uint64_t MonosChargeBegin(void) {
+    MonosBudget *b = currentBudget();
+    if (charging || b->deadline == 0 || pthread_equal(b->owner, pthread_self()))
+        return 0;
+    uint64_t start = threadCpuTime(pthread_self());
+    charging = start != 0;
+    return start;
+}
+
+void MonosChargeEnd(uint64_t start) {
+    if (start == 0)
+        return;
+    charging = false;
+    uint64_t now = threadCpuTime(pthread_self());
+    if (now > start)
+        atomic_fetch_add(&currentBudget()->charged, now - start);
+}
+
+bool MonosBudgetLimited(void) {
+    return MonosGetBudget() != 0 || currentBudget()->deadline != 0;
+}
+
+bool MonosTimeExpired(void) {
+    return atomic_load(&currentBudget()->expired);
+}
+
+/**
+ * Sprawdza, czy minął limit czasu obliczeń budżetu. Pierwsze wykrycie
+ * przekroczenia jest liczone jak przekroczenie limitu pamięci, żeby
+ * wynik przerwanych obliczeń został odrzucony.
+ * @param[in] b : budżet
+ * @return Czy limit czasu został przekroczony?
+ */
+static bool budgetExpired(MonosBudget *b) {
+    if (b->deadline == 0)
+        return false;
+    if (atomic_load(&b->expired))
+        return true;
+    if (threadCpuTime(b->owner) + atomic_load(&b->charged) < b->deadline)
+        return false;
+    if (!atomic_exchange(&b->expired, true))
+        atomic_fetch_add_explicit(&b->overflows, 1, memory_order_relaxed);
+    return true;
+}
+
+unsigned long MonosBudgetMark(void) {
+    return atomic_load_explicit(&currentBudget()->overflows, memory_order_relaxed);
+}
+
+bool MonosOverBudgetSince(unsigned long mark) {
+    return atomic_load_explicit(&currentBudget()->overflows, memory_order_relaxed) != mark;
+}
+
+bool MonosSetBudgetStop(bool stop) {
+    bool old = context.stop;
+    context.stop = stop;
+    return old;
+}
+
+bool MonosBudgetStop(void) {
+    if (!context.stop)
+        return false;
+    size_t limit = MonosGetBudget();
+    return (limit != 0 && MonosLiveBytes() > limit) || budgetExpired(currentBudget());
+}
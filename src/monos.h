@@ -0,0 +1,383 @@
+/** @file
+  Interfejs zarządzania pamięcią tablic jednomianów, z których zbudowane
+  są wielomiany.
+
+  Każda tablica jednomianów wielomianu jest poprzedzona nagłówkiem
+  przechowującym jej pojemność. Małe tablice (a takich jest najwięcej,
+  np. współczynniki postaci `(c, e)` tworzone przez parser) są brane
+  z puli wolnych bloków, dzięki czemu nie wymagają wywołania `malloc`.
+
+  Za tablicą jednomianów, w tym samym bloku, znajduje się spakowana
+  tablica ich wykładników. Pętle scalające i porównujące porównują
+  wykładniki w tej tablicy, zamiast czytać je z 24-bajtowych jednomianów,
+  a długie serie wykładników sprawdzają instrukcjami wektorowymi.
+  Wykładniki w strukturach Mono pozostają wiążące; tablica wykładników
+  jest uzupełniana przy kończeniu budowy wielomianu.
+
+  Moduł zlicza bajty zajmowane przez przydzielone tablice i pilnuje
+  opcjonalnego budżetu pamięci. Przydziały i zwolnienia są liczone
+  w budżecie bieżącego wątku (MonosUseBudget): każdy kalkulator ma własny
+  budżet, a przydziały wykonywane poza kalkulatorami trafiają do budżetu
+  procesu. Tablica musi być zwolniona w tym samym budżecie, w którym
+  została przydzielona. Przekroczenie budżetu nie przerywa przydziału, ale
+  jest zapamiętywane: długie obliczenia kończą się wtedy wcześniej
+  (z niepoprawnym wynikiem), a kalkulator odrzuca wynik instrukcji,
+  pozostawiając stos bez zmian.
+
+  Wielomian może też zostać zamrożony: wszystkie jego węzły są wtedy
+  przenoszone do jednego ciągłego bloku, w kolejności pre-order. Węzły
+  zamrożonego wielomianu mają zwykły układ (nagłówek, jednomiany,
+  wykładniki), więc operacje tylko czytające wielomian działają na nich
+  bez zmian; nie wolno ich jednak zwalniać ani zmieniać ich pojemności
+  pojedynczo. Zamrożone węzły mogą też leżeć w odwzorowanym w pamięć
+  pliku punktu kontrolnego; wtedy nie są zwalniane wcale.
+*/
+
+#ifndef _MONOS_H
+#define _MONOS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "poly.h"
+
+/** Największa pojemność tablicy jednomianów przydzielanej z puli. */
+#define MONOS_SMALL_CAPACITY 4
+
+/** Liczba pierwszych zmiennych, dla których zapamiętywany jest stopień. */
+#define MONOS_DEG_VARS 4
+
+/**
+ * Struktura przechowująca nagłówek tablicy jednomianów.
+ * Nagłówek znajduje się w pamięci bezpośrednio przed tablicą.
+ * Poza pojemnością tablicy przechowuje stopnie wielomianu, którego
+ * jednomiany są w tablicy, informację, czy jest on liściem (ma tylko
+ * stałe współczynniki), łączną liczbę jego jednomianów i zajmowanych
+ * przez niego bajtów, wyliczane podczas budowania wielomianu,
+ * oraz leniwie wyliczany skrót strukturalny tego wielomianu. Skrót węzła
+ * zamrożonego jest wyliczany przy zamrażaniu, więc nagłówki zamrożonych
+ * (także odwzorowanych z pliku) wielomianów nie są później zmieniane;
+ * skrót pozostałych węzłów może zapisywać kilka wątków naraz.
+ */
+typedef struct MonosHeader {
+    size_t capacity; ///< pojemność tablicy, liczba jednomianów
+    _Atomic uint64_t hash; ///< skrót wielomianu lub 0, jeśli nie został wyliczony
+    poly_exp_t deg;  ///< stopień wielomianu
+    poly_exp_t deg_by[MONOS_DEG_VARS]; ///< stopnie ze względu na pierwsze zmienne
+    bool leaf;       ///< czy wszystkie współczynniki jednomianów są stałymi
+    bool frozen;     ///< czy węzeł leży w bloku zamrożonego wielomianu
+    bool mapped;     ///< czy blok leży w odwzorowanym pliku punktu kontrolnego
+    size_t monos;    ///< liczba jednomianów całego wielomianu (z podwielomianami)
+    size_t bytes;    ///< liczba bajtów bloków całego wielomianu (z podwielomianami)
+} MonosHeader;
+
+/**
+ * Struktura przechowująca budżet pamięci: liczbę bajtów tablic
+ * przydzielonych w ramach budżetu i ich limit. Budżet może też ograniczać
+ * czas procesora obliczeń (MonosSetTimeLimit).
+ */
+typedef struct MonosBudget {
+    atomic_size_t live;     ///< liczba zajmowanych bajtów
+    atomic_size_t limit;    ///< limit (0 oznacza brak ograniczenia)
+    atomic_ulong overflows; ///< liczba przekroczeń limitu pamięci lub czasu
+    pthread_t owner;        ///< wątek, którego czas procesora jest ograniczony
+    uint64_t deadline;      ///< limit czasu procesora wątku owner (ns) lub 0
+    atomic_uint_least64_t charged; ///< czas procesora (ns) zużyty przez wątki puli
+    atomic_bool expired;    ///< czy limit czasu został przekroczony
+} MonosBudget;
+
+/**
+ * Struktura przechowująca kontekst przydziałów wątku. Zadania wykonywane
+ * w imieniu wątku przez wątki puli (WorkGroupSpawn) przejmują jego
+ * kontekst.
+ */
+typedef struct MonosContext {
+    MonosBudget *budget; ///< budżet, w którym są liczone przydziały, lub NULL
+                         ///< dla budżetu procesu
+    bool stop;           ///< czy przerywać obliczenia po przekroczeniu budżetu
+} MonosContext;
+
+/**
+ * Daje nagłówek tablicy jednomianów.
+ * @param[in] arr : tablica jednomianów przydzielona przez MonosAlloc
+ * @return nagłówek tablicy
+ */
+static inline MonosHeader *MonosGetHeader(const Mono *arr) {
+    return (MonosHeader *)arr - 1;
+}
+
+/**
+ * Daje pojemność tablicy jednomianów.
+ * @param[in] arr : tablica jednomianów przydzielona przez MonosAlloc
+ * @return pojemność tablicy
+ */
+static inline size_t MonosCapacity(const Mono *arr) {
+    return MonosGetHeader(arr)->capacity;
+}
+
+/**
+ * Daje spakowaną tablicę wykładników jednomianów tablicy @p arr.
+ * Tablica ma tę samą pojemność co tablica jednomianów.
+ * @param[in] arr : tablica jednomianów przydzielona przez MonosAlloc
+ * @return tablica wykładników
+ */
+static inline poly_exp_t *MonosExps(const Mono *arr) {
+    return (poly_exp_t *)(arr + MonosCapacity(arr));
+}
+
+/**
+ * Daje łączną liczbę jednomianów wielomianu (1 dla współczynnika).
+ * @param[in] p : wielomian
+ * @return liczba jednomianów
+ */
+static inline size_t MonosOfPoly(const Poly *p) {
+    return p->arr == NULL ? 1 : MonosGetHeader(p->arr)->monos;
+}
+
+/**
+ * Daje łączną liczbę bajtów bloków zajmowanych przez wielomian
+ * (0 dla współczynnika).
+ * @param[in] p : wielomian
+ * @return liczba bajtów
+ */
+static inline size_t MonosBytesOfPoly(const Poly *p) {
+    return p->arr == NULL ? 0 : MonosGetHeader(p->arr)->bytes;
+}
+
+/**
+ * Kopiuje informacje zapamiętane w nagłówku tablicy @p src
+ * do nagłówka tablicy @p dst (poza pojemnością i położeniem tablicy).
+ * @param[in] dst : tablica jednomianów
+ * @param[in] src : tablica jednomianów
+ */
+static inline void MonosCopyInfo(Mono *dst, const Mono *src) {
+    MonosHeader *h = MonosGetHeader(dst);
+    size_t capacity = h->capacity;
+    bool frozen = h->frozen;
+    bool mapped = h->mapped;
+    *h = *MonosGetHeader(src);
+    h->capacity = capacity;
+    h->frozen = frozen;
+    h->mapped = mapped;
+}
+
+/**
+ * Czy tablica jednomianów leży w bloku zamrożonego wielomianu?
+ * @param[in] arr : tablica jednomianów
+ * @return Czy tablica jest zamrożona?
+ */
+static inline bool MonosIsFrozen(const Mono *arr) {
+    return MonosGetHeader(arr)->frozen;
+}
+
+/**
+ * Liczy, ile początkowych wykładników malejącego ciągu jest większych
+ * od podanej wartości.
+ * @param[in] exps : malejący ciąg wykładników
+ * @param[in] n : długość ciągu
+ * @param[in] bound : wartość
+ * @return długość najdłuższego prefiksu o wykładnikach większych od @p bound
+ */
+size_t MonosCountAbove(const poly_exp_t *exps, size_t n, poly_exp_t bound);
+
+/**
+ * Daje rozmiar bloku (nagłówka, jednomianów i wykładników) tablicy
+ * o podanej pojemności.
+ * @param[in] capacity : pojemność tablicy
+ * @return rozmiar bloku w bajtach
+ */
+size_t MonosBlockSize(size_t capacity);
+
+/**
+ * Przydziela tablicę jednomianów o pojemności co najmniej @p capacity.
+ * @param[in] capacity : minimalna pojemność tablicy
+ * @return tablica jednomianów
+ */
+Mono *MonosAlloc(size_t capacity);
+
+/**
+ * Zmienia pojemność tablicy jednomianów, zachowując jej zawartość
+ * (do nowej pojemności). Tablica wykładników nie jest zachowywana.
+ * @param[in] arr : tablica jednomianów
+ * @param[in] capacity : nowa minimalna pojemność tablicy
+ * @return tablica jednomianów o zmienionej pojemności
+ */
+Mono *MonosResize(Mono *arr, size_t capacity);
+
+/**
+ * Zwalnia tablicę jednomianów (nie zwalnia samych jednomianów).
+ * @param[in] arr : tablica jednomianów
+ */
+void MonosFree(Mono *arr);
+
+/**
+ * Daje rozmiar węzła o podanej liczbie jednomianów w bloku zamrożonego
+ * wielomianu, z wyrównaniem dla nagłówka następnego węzła.
+ * @param[in] size : liczba jednomianów
+ * @return rozmiar węzła w bajtach
+ */
+static inline size_t MonosFrozenSize(size_t size) {
+    size_t align = _Alignof(MonosHeader);
+    return (MonosBlockSize(size) + align - 1) / align * align;
+}
+
+/**
+ * Przydziela blok na zamrożony wielomian. Blok jest wyrównany tak,
+ * żeby mógł zaczynać się nagłówkiem tablicy jednomianów.
+ * @param[in] bytes : rozmiar bloku
+ * @return blok
+ */
+void *MonosAllocFrozen(size_t bytes);
+
+/**
+ * Zwalnia blok zamrożonego wielomianu. Blok leżący w odwzorowanym
+ * pliku nie jest zwalniany.
+ * @param[in] arr : tablica jednomianów korzenia zamrożonego wielomianu
+ */
+void MonosFreeFrozen(Mono *arr);
+
+/**
+ * Przesuwa wskaźniki do tablic jednomianów w węzłach bloku zamrożonych
+ * wielomianów. Węzły leżą w bloku jeden za drugim, więc blok jest
+ * przeglądany liniowo. Pozwala zapisać blok w pliku niezależnie od
+ * adresu i odczytać go pod dowolnym innym adresem.
+ * @param[in] block : początek bloku
+ * @param[in] bytes : rozmiar bloku
+ * @param[in] delta : przesunięcie wskaźników
+ * @param[in] mapped : czy oznaczyć węzły jako leżące w odwzorowanym pliku
+ */
+void MonosRelocateFrozen(char *block, size_t bytes, uintptr_t delta, bool mapped);
+
+/**
+ * Oddaje systemowi bloki zgromadzone w puli bieżącego wątku.
+ */
+void MonosPoolRelease(void);
+
+/**
+ * Inicjuje pusty budżet pamięci.
+ * @param[out] budget : budżet
+ * @param[in] bytes : limit w bajtach (0 oznacza brak ograniczenia)
+ */
+void MonosBudgetInit(MonosBudget *budget, size_t bytes);
+
+/**
+ * Ustawia budżet, w którym są liczone przydziały i zwolnienia bieżącego
+ * wątku.
+ * @param[in] budget : budżet lub NULL dla budżetu procesu
+ * @return poprzedni budżet wątku
+ */
+MonosBudget *MonosUseBudget(MonosBudget *budget);
+
+/**
+ * Daje kontekst przydziałów bieżącego wątku.
+ * @return kontekst
+ */
+MonosContext MonosGetContext(void);
+
+/**
+ * Ustawia kontekst przydziałów bieżącego wątku.
+ * @param[in] context : kontekst
+ * @return poprzedni kontekst
+ */
+MonosContext MonosSetContext(MonosContext context);
+
+/**
+ * Ustawia limit bieżącego budżetu pamięci.
+ * @param[in] bytes : limit w bajtach (0 oznacza brak ograniczenia)
+ */
+void MonosSetBudget(size_t bytes);
+
+/**
+ * Daje limit bieżącego budżetu pamięci.
+ * @return limit w bajtach (0, jeśli nie ma ograniczenia)
+ */
+size_t MonosGetBudget(void);
+
+/**
+ * Daje liczbę bajtów zajmowanych przez tablice jednomianów przydzielone
+ * w bieżącym budżecie (bez wolnych bloków w pulach).
+ * @return liczba bajtów
+ */
+size_t MonosLiveBytes(void);
+
+/**
+ * Ustawia limit czasu obliczeń w bieżącym budżecie: po zużyciu przez
+ * bieżący wątek i wątki puli wykonujące zadania w jego imieniu podanego
+ * czasu procesora obliczenia są przerywane tak jak po przekroczeniu
+ * limitu pamięci.
+ * @param[in] seconds : limit w sekundach, liczony od teraz (0 oznacza brak
+ * ograniczenia)
+ */
+void MonosSetTimeLimit(double seconds);
+
+/**
+ * Daje czas procesora zużyty przez wątki puli na zadania bieżącego
+ * budżetu od ostatniego wywołania MonosSetTimeLimit. Czas jest liczony
+ * tylko wtedy, gdy limit czasu jest ustawiony.
+ * @return czas w sekundach
+ */
+double MonosChargedTime(void);
+
+/**
+ * Zaczyna mierzenie czasu procesora zadania wykonywanego przez bieżący
+ * wątek w imieniu innego wątku (zob. MonosChargeEnd).
+ * @return początek pomiaru lub 0, jeśli czas nie jest mierzony
+ */
+uint64_t MonosChargeBegin(void);
+
+/**
+ * Kończy mierzenie czasu zadania i dolicza go do bieżącego budżetu.
+ * @param[in] start : wynik MonosChargeBegin
+ */
+void MonosChargeEnd(uint64_t start);
+
+/**
+ * Czy bieżący budżet ogranicza pamięć albo czas obliczeń?
+ * @return Czy obliczenia mogą zostać przerwane?
+ */
+bool MonosBudgetLimited(void);
+
+/**
+ * Czy obliczenia w bieżącym budżecie zostały przerwane po przekroczeniu
+ * limitu czasu?
+ * @return Czy limit czasu został przekroczony?
+ */
+bool MonosTimeExpired(void);
+
+/**
+ * Daje znacznik stanu budżetu, od którego można później sprawdzić,
+ * czy budżet został przekroczony.
+ * @return znacznik
+ */
+unsigned long MonosBudgetMark(void);
+
+/**
+ * Czy bieżący budżet pamięci (albo limit czasu obliczeń) został
+ * przekroczony od chwili, w której dano podany znacznik? Obejmuje przydziały wszystkich wątków liczone w tym
+ * budżecie, także wykonane przez wątki puli w imieniu bieżącego wątku.
+ * @param[in] mark : znacznik dany przez MonosBudgetMark
+ * @return Czy budżet został przekroczony?
+ */
+bool MonosOverBudgetSince(unsigned long mark);
+
+/**
+ * Włącza lub wyłącza przerywanie obliczeń bieżącego wątku po przekroczeniu
+ * budżetu (domyślnie włączone). Przerywanie trzeba wyłączyć na czas
+ * obliczeń, których wynik jest zapamiętywany niezależnie od powodzenia
+ * instrukcji.
+ * @param[in] stop : czy przerywać obliczenia
+ * @return poprzednie ustawienie
+ */
+bool MonosSetBudgetStop(bool stop);
+
+/**
+ * Czy obliczenia bieżącego wątku powinny zostać przerwane, bo pamięć
+ * zajmowana w bieżącym budżecie przekracza jego limit albo minął limit
+ * czasu obliczeń?
+ * @return Czy przerwać obliczenia?
+ */
+bool MonosBudgetStop(void);
+
+#endif //_MONOS_H
@@ -2,37 +2,440 @@
   Implementacja klasy wielomianów rzadkich wielu zmiennych
 */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdbool.h>
 #include <stddef.h>
 #include "poly.h"
+#include "monos.h"
+#include "poly_walk.h"
+#include "poly_accumulator.h"
+#include "poly_dense.h"
+#include "poly_trace.h"
+#include "work_pool.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <assert.h>
+#include <pthread.h>
+#include <unistd.h>
 
-void PolyDestroy(Poly *p) {
-    if (p->arr != NULL) {
-        for (unsigned int i = 0; i < p->size; i++)
-            PolyDestroy(&(p->arr[i].p));
-        if (p->arr != NULL) {
-            free(p->arr);
-            p->arr = NULL;
+/** Najmniejsza liczba bajtów poddrzewa przetwarzanego w osobnym zadaniu. */
+#define POLY_FORK_MIN_BYTES (256 << 10)
+
+/** Największa głębokość zagnieżdżenia zadań przetwarzających poddrzewa. */
+#define POLY_FORK_MAX_DEPTH 8
+
+/** Pula wykonująca zadania operacji na wielomianach lub NULL. */
+static WorkPool *fork_pool = NULL;
+
+/** Zapewnia jednokrotne ustalenie puli. */
+static pthread_once_t fork_once = PTHREAD_ONCE_INIT;
+
+/**
+ * Ustala pulę wykonującą zadania: wspólną pulę, jeśli jest więcej niż
+ * jeden procesor.
+ */
+static void PolyForkInit(void) {
+    if (sysconf(_SC_NPROCESSORS_ONLN) > 1)
+        fork_pool = WorkPoolShared();
+}
+
+/**
+ * Daje pulę wykonującą zadania operacji na wielomianach.
+ * @return pula lub NULL, jeśli operacje mają być wykonywane w jednym wątku
+ */
+static WorkPool *PolyForkPool(void) {
+    pthread_once(&fork_once, PolyForkInit);
+    return fork_pool;
+}
+
+/**
+ * Struktura przechowująca operację wykonywaną osobno dla każdego
+ * współczynnika wielomianu.
+ */
+typedef struct PolyFork PolyFork;
+
+/**
+ * Typ funkcji przetwarzającej jeden współczynnik.
+ * @param[in] f : operacja
+ * @param[in] i : numer jednomianu
+ */
+typedef void (*PolyForkFunc)(const PolyFork *f, size_t i);
+
+struct PolyFork {
+    const Poly *p;   ///< wielomian, którego współczynniki są przetwarzane
+    unsigned depth;  ///< głębokość zagnieżdżenia zadań
+    PolyForkFunc fn; ///< funkcja przetwarzająca współczynnik
+    void *ctx;       ///< dane operacji
+};
+
+/**
+ * Struktura przechowująca zadanie przetworzenia jednego współczynnika.
+ */
+typedef struct PolyForkTask {
+    const PolyFork *f; ///< operacja
+    size_t i;          ///< numer jednomianu
+} PolyForkTask;
+
+/**
+ * Sprawdza, czy współczynniki wielomianu warto przetwarzać współbieżnie.
+ * @param[in] p : wielomian
+ * @param[in] depth : głębokość zagnieżdżenia zadań
+ * @return Czy warto?
+ */
+static bool PolyForkWorth(const Poly *p, unsigned depth) {
+    return depth < POLY_FORK_MAX_DEPTH && !PolyIsCoeff(p) && p->size > 1
+           && MonosBytesOfPoly(p) >= 2 * POLY_FORK_MIN_BYTES && PolyForkPool() != NULL;
+}
+
+/**
+ * Sprawdza, czy współczynnik jest wystarczająco duży na osobne zadanie.
+ * @param[in] c : współczynnik
+ * @return Czy jest wystarczająco duży?
+ */
+static bool PolyForkChild(const Poly *c) {
+    return !PolyIsCoeff(c) && MonosBytesOfPoly(c) >= POLY_FORK_MIN_BYTES;
+}
+
+/**
+ * Wykonuje zadanie przetworzenia współczynnika.
+ * @param[in] arg : zadanie
+ */
+static void PolyForkRun(void *arg) {
+    PolyForkTask *t = arg;
+    t->f->fn(t->f, t->i);
+}
+
+/**
+ * Przetwarza wszystkie współczynniki wielomianu: duże w osobnych
+ * zadaniach wspólnej puli, pozostałe w bieżącym wątku. Wraca po
+ * przetworzeniu wszystkich. Wyniki dla kolejnych współczynników muszą
+ * trafiać w osobne miejsca, żeby nie zależały od kolejności wykonania.
+ * @param[in] f : operacja
+ */
+static void PolyForkEach(const PolyFork *f) {
+    const Poly *p = f->p;
+    PolyForkTask *tasks = malloc(p->size * sizeof(PolyForkTask));
+    if (tasks == NULL)
+        exit(1);
+    WorkGroup g;
+    WorkGroupInit(&g, PolyForkPool());
+    size_t n = 0;
+    // zadania mogą zmieniać swoje współczynniki (PolyDestroy), więc każdy
+    // współczynnik jest sprawdzany tylko raz, zanim trafi do zadania
+    for (size_t i = 0; i < p->size; i++) {
+        if (PolyForkChild(&p->arr[i].p)) {
+            tasks[n] = (PolyForkTask) {.f = f, .i = i};
+            WorkGroupSpawn(&g, PolyForkRun, &tasks[n++]);
+        }
+        else {
+            f->fn(f, i);
         }
     }
+    WorkGroupJoin(&g);
+    free(tasks);
 }
 
-Poly PolyClone(const Poly *p) {
+static void PolyDestroyAt(Poly *p, unsigned depth);
+
+/**
+ * Usuwa współczynnik wielomianu.
+ * @param[in] f : operacja (ctx to usuwany wielomian)
+ * @param[in] i : numer jednomianu
+ */
+static void PolyDestroyChild(const PolyFork *f, size_t i) {
+    Poly *p = f->ctx;
+    PolyDestroyAt(&p->arr[i].p, f->depth + 1);
+}
+
+/**
+ * Usuwa wielomian z pamięci, usuwając duże poddrzewa współbieżnie.
+ * @param[in] p : wielomian
+ * @param[in] depth : głębokość zagnieżdżenia zadań
+ */
+static void PolyDestroyAt(Poly *p, unsigned depth) {
+    if (PolyIsCoeff(p))
+        return;
+    if (MonosIsFrozen(p->arr)) {
+        MonosFreeFrozen(p->arr);
+        p->arr = NULL;
+        return;
+    }
+    if (PolyForkWorth(p, depth)) {
+        PolyFork f = {.p = p, .depth = depth, .fn = PolyDestroyChild, .ctx = p};
+        PolyForkEach(&f);
+        MonosFree(p->arr);
+        p->arr = NULL;
+        return;
+    }
+
+    PolyWalk w;
+    PolyWalkInit(&w);
+    PolyWalkPush(&w, p, NULL, p);
+    while (!PolyWalkIsEmpty(&w)) {
+        PolyWalkFrame *f = PolyWalkTop(&w);
+        if (f->i < f->res->size) {
+            Poly *c = &f->res->arr[f->i++].p;
+            if (PolyIsCoeff(c))
+                continue;
+            // zamrożony wielomian mógł zostać w całości przeniesiony
+            // do zwykłego węzła, więc jest tu korzeniem swojego bloku
+            if (MonosIsFrozen(c->arr)) {
+                MonosFreeFrozen(c->arr);
+                c->arr = NULL;
+            }
+            else {
+                PolyWalkPush(&w, c, NULL, c);
+            }
+        }
+        else {
+            MonosFree(f->res->arr);
+            f->res->arr = NULL;
+            PolyWalkPop(&w);
+        }
+    }
+    PolyWalkFree(&w);
+}
+
+void PolyDestroy(Poly *p) {
+    PolyDestroyAt(p, 0);
+}
+
+/**
+ * Tworzy pustą kopię węzła wielomianu: przydziela tablicę jednomianów
+ * i kopiuje informacje z nagłówka, ale nie kopiuje jednomianów.
+ * Liczba bajtów w nagłówku obejmuje tylko blok samego węzła.
+ * @param[in] p : wielomian niebędący współczynnikiem
+ * @return wielomian z nieuzupełnioną tablicą jednomianów
+ */
+static Poly PolyCloneNode(const Poly *p) {
+    Poly q = {.size = p->size, .arr = MonosAlloc(p->size + 1)};
+    MonosCopyInfo(q.arr, p->arr);
+    MonosGetHeader(q.arr)->bytes = MonosBlockSize(MonosCapacity(q.arr));
+    memcpy(MonosExps(q.arr), MonosExps(p->arr), p->size * sizeof(poly_exp_t));
+    return q;
+}
+
+static Poly PolyCloneAt(const Poly *p, unsigned depth);
+
+/**
+ * Kopiuje jednomian wielomianu do kopii węzła.
+ * @param[in] f : operacja (ctx to kopia węzła)
+ * @param[in] i : numer jednomianu
+ */
+static void PolyCloneChild(const PolyFork *f, size_t i) {
+    const Mono *m = &f->p->arr[i];
+    Mono *r = &((Poly *)f->ctx)->arr[i];
+    r->exp = m->exp;
+    r->p = PolyIsCoeff(&m->p) ? m->p : PolyCloneAt(&m->p, f->depth + 1);
+}
+
+/**
+ * Robi pełną, głęboką kopię wielomianu, kopiując duże poddrzewa
+ * współbieżnie.
+ * @param[in] p : wielomian
+ * @param[in] depth : głębokość zagnieżdżenia zadań
+ * @return skopiowany wielomian
+ */
+static Poly PolyCloneAt(const Poly *p, unsigned depth) {
     if (p->arr == NULL)
         return PolyFromCoeff(p->coeff);
 
-    Mono * arr = malloc((p->size + 1) * sizeof(Mono));
-    if (arr == NULL)
-        exit(1);
-    Poly q = {.size = p->size, .arr = arr};
-    for (unsigned int i = 0; i < p->size; i++)
-        q.arr[i] = MonoClone(&p->arr[i]);
+    Poly q = PolyCloneNode(p);
+    if (PolyForkWorth(p, depth)) {
+        PolyFork f = {.p = p, .depth = depth, .fn = PolyCloneChild, .ctx = &q};
+        PolyForkEach(&f);
+        for (size_t i = 0; i < q.size; i++)
+            MonosGetHeader(q.arr)->bytes += MonosBytesOfPoly(&q.arr[i].p);
+        return q;
+    }
+
+    PolyWalk w;
+    PolyWalkInit(&w);
+    PolyWalkPush(&w, p, NULL, &q);
+    while (!PolyWalkIsEmpty(&w)) {
+        PolyWalkFrame *f = PolyWalkTop(&w);
+        if (f->i < f->p->size) {
+            const Mono *m = &f->p->arr[f->i];
+            Mono *r = &f->res->arr[f->i];
+            f->i++;
+            r->exp = m->exp;
+            if (PolyIsCoeff(&m->p)) {
+                r->p = m->p;
+            }
+            else {
+                r->p = PolyCloneNode(&m->p);
+                PolyWalkPush(&w, &m->p, NULL, &r->p);
+            }
+        }
+        else {
+            size_t bytes = MonosBytesOfPoly(f->res);
+            PolyWalkPop(&w);
+            // kopia może mieć inne pojemności tablic niż oryginał
+            if (!PolyWalkIsEmpty(&w))
+                MonosGetHeader(PolyWalkTop(&w)->res->arr)->bytes += bytes;
+        }
+    }
+    PolyWalkFree(&w);
+    return q;
+}
+
+Poly PolyClone(const Poly *p) {
+    return PolyCloneAt(p, 0);
+}
+
+/**
+ * Daje rozmiar bloku potrzebnego do zamrożenia wielomianu.
+ * @param[in] p : wielomian niebędący współczynnikiem
+ * @return rozmiar bloku w bajtach
+ */
+static size_t PolyFrozenSize(const Poly *p) {
+    size_t bytes = MonosFrozenSize(p->size);
+    PolyWalk w;
+    PolyWalkInit(&w);
+    PolyWalkPush(&w, p, NULL, NULL);
+    while (!PolyWalkIsEmpty(&w)) {
+        PolyWalkFrame *f = PolyWalkTop(&w);
+        if (f->i < f->p->size) {
+            const Poly *c = &f->p->arr[f->i++].p;
+            if (!PolyIsCoeff(c)) {
+                bytes += MonosFrozenSize(c->size);
+                PolyWalkPush(&w, c, NULL, NULL);
+            }
+        }
+        else {
+            PolyWalkPop(&w);
+        }
+    }
+    PolyWalkFree(&w);
+    return bytes;
+}
+
+/**
+ * Tworzy w bloku zamrożonego wielomianu pustą kopię węzła: kopiuje
+ * nagłówek i wykładniki, ale nie kopiuje jednomianów.
+ * @param[in] p : wielomian niebędący współczynnikiem
+ * @param[in,out] cursor : wolne miejsce w bloku, przesuwane za węzeł
+ * @return wielomian z nieuzupełnioną tablicą jednomianów
+ */
+static Poly PolyFreezeNode(const Poly *p, char **cursor) {
+    MonosHeader *h = (MonosHeader *)*cursor;
+    *h = *MonosGetHeader(p->arr);
+    h->capacity = p->size;
+    h->frozen = true;
+    h->mapped = false;
+    *cursor += MonosFrozenSize(p->size);
+    Poly q = {.size = p->size, .arr = (Mono *)(h + 1)};
+    memcpy(MonosExps(q.arr), MonosExps(p->arr), p->size * sizeof(poly_exp_t));
     return q;
 }
 
+void PolyFreeze(Poly *p) {
+    if (PolyIsCoeff(p) || MonosIsFrozen(p->arr))
+        return;
+
+    // nagłówki zamrożonego wielomianu nie są później zmieniane, więc skróty
+    // są wyliczane przed skopiowaniem ich do bloku
+    PolyHash(p);
+    char *cursor = MonosAllocFrozen(PolyFrozenSize(p));
+    Poly q = PolyFreezeNode(p, &cursor);
+    // węzły są przydzielane przy wchodzeniu do nich, więc leżą w bloku
+    // w kolejności pre-order, a każde poddrzewo zajmuje spójny fragment
+    PolyWalk w;
+    PolyWalkInit(&w);
+    PolyWalkPush(&w, p, NULL, &q);
+    while (!PolyWalkIsEmpty(&w)) {
+        PolyWalkFrame *f = PolyWalkTop(&w);
+        if (f->i < f->p->size) {
+            const Mono *m = &f->p->arr[f->i];
+            Mono *r = &f->res->arr[f->i];
+            f->i++;
+            r->exp = m->exp;
+            if (PolyIsCoeff(&m->p)) {
+                r->p = m->p;
+            }
+            else {
+                r->p = PolyFreezeNode(&m->p, &cursor);
+                PolyWalkPush(&w, &m->p, NULL, &r->p);
+            }
+        }
+        else {
+            MonosHeader *h = MonosGetHeader(f->res->arr);
+            h->bytes = (size_t)(cursor - (char *)h);
+            PolyWalkPop(&w);
+        }
+    }
+    PolyWalkFree(&w);
+    PolyDestroy(p);
+    *p = q;
+}
+
+void PolyThaw(Poly *p) {
+    if (!PolyIsFrozen(p))
+        return;
+    Poly q = PolyClone(p);
+    PolyDestroy(p);
+    *p = q;
+}
+
+bool PolyIsFrozen(const Poly *p) {
+    return !PolyIsCoeff(p) && MonosIsFrozen(p->arr);
+}
+
+/**
+ * Zwraca maksimum dwóch współczynników.
+ * @param[in] a : wartość współczynnika
+ * @param[in] b : wartość współczynnika
+ * @return @f$max(a, b)@f$
+ */
+poly_exp_t max(poly_exp_t a, poly_exp_t b) {
+    if (a < b)
+        return b;
+    return a;
+}
+
+/**
+ * Uzupełnia informacje zapamiętane w nagłówku tablicy jednomianów wielomianu.
+ * Korzysta ze stopni zapamiętanych we współczynnikach, więc działa w czasie
+ * liniowym względem liczby jednomianów wielomianu. Skrót wielomianu jest
+ * unieważniany i zostanie wyliczony przy pierwszym użyciu. Uzupełnia też
+ * tablicę wykładników.
+ * @param[in] p : wielomian niebędący współczynnikiem
+ */
+static void PolyUpdateInfo(Poly *p) {
+    assert(!PolyIsCoeff(p));
+    MonosHeader *h = MonosGetHeader(p->arr);
+    poly_exp_t *exps = MonosExps(p->arr);
+    atomic_store_explicit(&h->hash, 0, memory_order_relaxed);
+    h->deg = 0;
+    h->leaf = true;
+    h->monos = p->size;
+    h->bytes = MonosBlockSize(h->capacity);
+    h->deg_by[0] = p->size > 0 ? p->arr[0].exp : -1;
+    for (size_t v = 1; v < MONOS_DEG_VARS; v++)
+        h->deg_by[v] = -1;
+    for (size_t i = 0; i < p->size; i++) {
+        const Poly *c = &p->arr[i].p;
+        exps[i] = p->arr[i].exp;
+        if (PolyIsCoeff(c)) {
+            poly_exp_t d = PolyIsZero(c) ? -1 : 0;
+            h->deg = max(h->deg, d + p->arr[i].exp);
+            for (size_t v = 1; v < MONOS_DEG_VARS; v++)
+                h->deg_by[v] = max(h->deg_by[v], d);
+        }
+        else {
+            const MonosHeader *ch = MonosGetHeader(c->arr);
+            h->leaf = false;
+            h->monos += ch->monos;
+            h->bytes += ch->bytes;
+            h->deg = max(h->deg, ch->deg + p->arr[i].exp);
+            for (size_t v = 1; v < MONOS_DEG_VARS; v++)
+                h->deg_by[v] = max(h->deg_by[v], ch->deg_by[v - 1]);
+        }
+    }
+}
+
 /**
  * Sprawdza, czy wielomian jest rekurencyjnym wielomianem zerowym.
  * Zwraca true jeśli @f$p = rx_i^0@f$ gdzie @f$r@f$ jest rekurencyjnym
@@ -41,13 +444,9 @@ Poly PolyClone(const Poly *p) {
  * @return Czy wielomian jest rekurencyjnym wielomianem zerowym?
  */
 bool PolyIsZeroRec(Poly *p) {
-    if (PolyIsZero(p))
-        return true;
-    if (PolyIsCoeff(p))
-        return false;
-    if (p->size == 1 && p->arr[0].exp == 0)
-        return PolyIsZeroRec(&p->arr[0].p);
-    return false;
+    while (!PolyIsCoeff(p) && p->size == 1 && p->arr[0].exp == 0)
+        p = &p->arr[0].p;
+    return PolyIsZero(p);
 }
 
 /**
@@ -59,10 +458,10 @@ bool PolyIsZeroRec(Poly *p) {
  */
 poly_coeff_t PolyIsCoeffRec(Poly *p) {
     assert(!PolyIsZeroRec(p));
-    if (p->size == 1 && p->arr[0].exp == 0) {
+    while (p->size == 1 && p->arr[0].exp == 0) {
         if (PolyIsCoeff(&p->arr[0].p))
             return p->arr[0].p.coeff;
-        return PolyIsCoeffRec(&p->arr[0].p);
+        p = &p->arr[0].p;
     }
     return 0;
 }
@@ -87,6 +486,105 @@ Poly PolySimplify(Poly *p) {
     return *p;
 }
 
+/**
+ * Kończy budowanie wielomianu, którego @p k pierwszych jednomianów zostało
+ * zapisanych w tablicy @p res->arr w kolejności malejących wykładników.
+ * Zwalnia zbędną pamięć, uzupełnia informacje w nagłówku tablicy
+ * i sprowadza wielomian do najprostszej postaci.
+ * @param[in] res : budowany wielomian
+ * @param[in] k : liczba jednomianów
+ * @return zbudowany wielomian
+ */
+static Poly PolyFinish(Poly *res, size_t k) {
+    if (k == 0) {
+        MonosFree(res->arr);
+        return PolyZero();
+    }
+    if (k == 1 && res->arr[0].exp == 0 && PolyIsCoeff(&res->arr[0].p)) {
+        Poly r_coeff = PolyFromCoeff(res->arr[0].p.coeff);
+        MonosFree(res->arr);
+        return r_coeff;
+    }
+    res->size = k;
+    res->arr = MonosResize(res->arr, k + 1);
+    PolyUpdateInfo(res);
+    return PolySimplify(res);
+}
+
+/**
+ * Sprawdza, czy wielomian jest gęstym liściem, czyli ma tylko stałe
+ * współczynniki, co najmniej DENSE_MIN_SIZE jednomianów i jednomiany
+ * dla co najmniej połowy wykładników od 0 do swojego stopnia.
+ * @param[in] p : wielomian
+ * @return Czy wielomian jest gęstym liściem?
+ */
+static bool PolyIsDenseLeaf(const Poly *p) {
+    if (PolyIsCoeff(p) || p->size < DENSE_MIN_SIZE)
+        return false;
+    const MonosHeader *h = MonosGetHeader(p->arr);
+    return h->leaf && 2 * (size_t)p->size > (size_t)h->deg_by[0];
+}
+
+/**
+ * Zapisuje liść jako gęsty wektor współczynników.
+ * @param[in] p : liść
+ * @param[in] n : długość wektora, większa od stopnia liścia
+ * @return wektor współczynników
+ */
+static uint64_t *PolyToDense(const Poly *p, size_t n) {
+    uint64_t *c = calloc(n, sizeof(uint64_t));
+    if (c == NULL)
+        exit(1);
+    const poly_exp_t *exps = MonosExps(p->arr);
+    for (size_t i = 0; i < p->size; i++)
+        c[exps[i]] = (uint64_t)p->arr[i].p.coeff;
+    return c;
+}
+
+/**
+ * Tworzy wielomian z gęstego wektora współczynników i zwalnia wektor.
+ * @param[in] c : wektor współczynników
+ * @param[in] n : długość wektora
+ * @return wielomian
+ */
+static Poly PolyFromDense(uint64_t *c, size_t n) {
+    size_t k = 0;
+    for (size_t e = 0; e < n; e++)
+        k += c[e] != 0;
+    Poly res = {.size = k, .arr = MonosAlloc(k + 1)};
+    k = 0;
+    for (size_t e = n; e-- > 0;) {
+        if (c[e] != 0)
+            res.arr[k++] = (Mono) {.p = PolyFromCoeff((poly_coeff_t)c[e]), .exp = e};
+    }
+    free(c);
+    return PolyFinish(&res, k);
+}
+
+/**
+ * Dodaje dwa gęste liście.
+ * @param[in] p : gęsty liść @f$p@f$
+ * @param[in] q : gęsty liść @f$q@f$
+ * @return @f$p + q@f$
+ */
+static Poly PolyAddDense(const Poly *p, const Poly *q) {
+    size_t np = MonosGetHeader(p->arr)->deg_by[0] + 1;
+    size_t nq = MonosGetHeader(q->arr)->deg_by[0] + 1;
+    if (np < nq) {
+        const Poly *t = p;
+        p = q;
+        q = t;
+        size_t tn = np;
+        np = nq;
+        nq = tn;
+    }
+    uint64_t *c = PolyToDense(p, np);
+    uint64_t *d = PolyToDense(q, nq);
+    DenseAdd(c, d, nq);
+    free(d);
+    return PolyFromDense(c, np);
+}
+
 /**
  * Dodaje wyraz wolny do wielomianu.
  * @param[in] p : wielomian @f$p@f$
@@ -115,174 +613,444 @@ Poly PolyAddCoeff(const Poly *p, poly_coeff_t c) {
         else
             q.arr[i].p = r;
     }
+    if (q.size > 0)
+        PolyUpdateInfo(&q);
     return q;
 }
 
+/** Najmniejsza łączna liczba jednomianów argumentów dodawania, od której
+ * jednomiany są scalane współbieżnie. */
+#define ADD_PARALLEL_MIN_MONOS (1 << 16)
 
-Poly PolyAdd(const Poly *p, const Poly *q) {
-    if (PolyIsZero(p))
-        return PolyClone(q);
-    if (PolyIsZero(q))
-        return PolyClone(p);
-    if (PolyIsCoeff(p))
-        return PolyAddCoeff(q, p->coeff);
-    if (PolyIsCoeff(q))
-        return PolyAddCoeff(p, q->coeff);
+/** Liczba części scalanych współbieżnie na jeden wątek puli. */
+#define ADD_PARALLEL_PARTS 4
 
-    Mono * arr = malloc((p->size + q->size) * sizeof(Mono));
-    if (arr == NULL)
-        exit(1);
-    Poly res = {.size = p->size + q->size, .arr = arr};
-    unsigned int i = 0;
-    unsigned int j = 0;
-    unsigned int k = 0;
-    int p_exp, q_exp;
-    while (i < p->size && j < q->size) {
-        p_exp = MonoGetExp(&p->arr[i]);
-        q_exp = MonoGetExp(&q->arr[j]);
+/**
+ * Scala fragmenty tablic jednomianów dwóch wielomianów, dodając
+ * współczynniki przy równych wykładnikach. Jednomiany o zerowej sumie
+ * współczynników są pomijane.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] i : początek fragmentu jednomianów @f$p@f$
+ * @param[in] i_end : koniec fragmentu jednomianów @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @param[in] j : początek fragmentu jednomianów @f$q@f$
+ * @param[in] j_end : koniec fragmentu jednomianów @f$q@f$
+ * @param[out] out : miejsce na co najwyżej @f$(i_{end} - i) + (j_{end} - j)@f$
+ * jednomianów
+ * @return liczba zapisanych jednomianów
+ */
+static size_t PolyAddMerge(const Poly *p, size_t i, size_t i_end,
+                           const Poly *q, size_t j, size_t j_end, Mono *out) {
+    const poly_exp_t *p_exps = MonosExps(p->arr);
+    const poly_exp_t *q_exps = MonosExps(q->arr);
+    size_t k = 0;
+    while (i < i_end && j < j_end) {
+        poly_exp_t p_exp = p_exps[i];
+        poly_exp_t q_exp = q_exps[j];
         if (p_exp > q_exp) {
-            res.arr[k] = MonoClone(&p->arr[i]);
-            i++;
-            k++;
+            size_t run = MonosCountAbove(p_exps + i, i_end - i, q_exp);
+            for (; run > 0; run--)
+                out[k++] = MonoClone(&p->arr[i++]);
         }
         else if (q_exp > p_exp) {
-            res.arr[k] = MonoClone(&q->arr[j]);
-            j++;
-            k++;
+            size_t run = MonosCountAbove(q_exps + j, j_end - j, p_exp);
+            for (; run > 0; run--)
+                out[k++] = MonoClone(&q->arr[j++]);
         }
         else {
-           Poly sum = PolyAdd(&p->arr[i].p, &q->arr[j].p);
-           if (!(PolyIsZero(&sum))) {
-                res.arr[k] = (Mono) {.p = sum, .exp = p_exp};
-                k++;
-            }
-                i++;
-                j++;
+            Poly sum = PolyAdd(&p->arr[i].p, &q->arr[j].p);
+            if (!PolyIsZero(&sum))
+                out[k++] = (Mono) {.p = sum, .exp = p_exp};
+            i++;
+            j++;
         }
     }
-
-    while (i < p->size) {
-        res.arr[k] = MonoClone(&p->arr[i]);
-        i++;
-        k++;
-    }
-    while (j < q->size) {
-        res.arr[k] = MonoClone(&q->arr[j]);
-        j++;
-        k++;
-    }
-    if (k == 0) {
-        free(res.arr);
-        return PolyZero();
-    }
-    if (k == 1 && res.arr[0].exp == 0 && PolyIsCoeff(&res.arr[0].p)) {
-        Poly r_coeff = PolyFromCoeff(res.arr[0].p.coeff);
-        free(res.arr);
-        return r_coeff;
-    }
-    res.size = k;
-    res.arr = realloc(res.arr, (k + 1) * sizeof (Mono));
-    res = PolySimplify(&res);
-    return res;
+    while (i < i_end)
+        out[k++] = MonoClone(&p->arr[i++]);
+    while (j < j_end)
+        out[k++] = MonoClone(&q->arr[j++]);
+    return k;
 }
 
 /**
- * Porównuje jednomiany pod względem wykładnika.
- * @param[in] mm : jednomian
- * @param[in] nn : jednomian
- * @return liczba @f$k@f$: @f$k < 0@f$ jeśli deg @f$mm@f$ > deg @f$nn@f$,
- * @f$k > 0@f$ jeśli deg @f$mm@f$ < deg @f$nn@f$,
- * @f$k = 0@f$ jeśli deg @f$mm@f$ = deg @f$nn@f$.
+ * Struktura przechowująca zadanie scalenia jednej części jednomianów
+ * dodawanych wielomianów.
  */
-static int MonosCompare(const void * mm, const void * nn) {
-    Mono m = *(Mono*)mm;
-    Mono n = *(Mono*)nn;
-    return n.exp - m.exp;
-}
+typedef struct AddRange {
+    const Poly *p; ///< wielomian @f$p@f$
+    const Poly *q; ///< wielomian @f$q@f$
+    size_t i;      ///< początek fragmentu jednomianów @f$p@f$
+    size_t i_end;  ///< koniec fragmentu jednomianów @f$p@f$
+    size_t j;      ///< początek fragmentu jednomianów @f$q@f$
+    size_t j_end;  ///< koniec fragmentu jednomianów @f$q@f$
+    Mono *out;     ///< miejsce na wynik części
+    size_t k;      ///< liczba jednomianów wyniku części
+} AddRange;
 
 /**
- * Sortuje tablicę jednomianów pod względem wykładników.
- * @param[in] monos : tablica jednomianów
- * @param[in] count : liczba jednomianów
+ * Wykonuje zadanie scalenia części jako zadanie puli.
+ * @param[in] arg : zadanie
  */
-void MonosSort(Mono* monos, size_t count) {
-    qsort(monos, count, sizeof(Mono), MonosCompare);
+static void AddRangeRun(void *arg) {
+    AddRange *r = arg;
+    r->k = PolyAddMerge(r->p, r->i, r->i_end, r->q, r->j, r->j_end, r->out);
 }
 
-Poly PolyAddMonos(size_t count, const Mono monos[]) {
-    if (count == 0)
-        return PolyZero();
-    if (count == 1) {
-        Mono * arr = malloc(2 * sizeof(Mono));
-        if (arr == NULL)
-            exit(1);
-        arr[0] = monos[0];
-        Poly p = (Poly) {.size = 1, .arr = arr};
-        p = PolySimplify(&p);
-        return p;
+/**
+ * Znajduje punkt na ścieżce scalania dwóch malejących ciągów wykładników:
+ * liczbę @f$i@f$ wykładników @p p_exps i liczbę @f$j@f$ wykładników
+ * @p q_exps, które razem tworzą początek scalonego ciągu długości @p d.
+ * Wykładnik pierwszego ciągu poprzedza równy mu wykładnik drugiego;
+ * gdyby para równych wykładników znalazła się na granicy, @f$j@f$ jest
+ * zwiększane o jeden, żeby para trafiła do tej samej części.
+ * @param[in] p_exps : wykładniki @f$p@f$
+ * @param[in] np : liczba wykładników @f$p@f$
+ * @param[in] q_exps : wykładniki @f$q@f$
+ * @param[in] nq : liczba wykładników @f$q@f$
+ * @param[in] d : długość początku scalonego ciągu
+ * @param[out] j : liczba wykładników @f$q@f$
+ * @return liczba wykładników @f$p@f$
+ */
+static size_t PolyAddSplit(const poly_exp_t *p_exps, size_t np,
+                           const poly_exp_t *q_exps, size_t nq, size_t d, size_t *j) {
+    size_t lo = d > nq ? d - nq : 0;
+    size_t hi = d < np ? d : np;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (p_exps[mid] >= q_exps[d - mid - 1])
+            lo = mid + 1;
+        else
+            hi = mid;
     }
-    else {
-        Mono * monos_cpy = malloc((count + 1) * sizeof(Mono));
-        if (monos_cpy == NULL)
-            exit(1);
-        for (unsigned int i = 0; i < count; i++) {
-            monos_cpy[i] = monos[i];
-        }
-        MonosSort(monos_cpy, count);
-        monos_cpy[count] = (Mono) {.p = PolyZero(), .exp = -1};
+    *j = d - lo;
+    if (lo > 0 && *j < nq && p_exps[lo - 1] == q_exps[*j])
+        (*j)++;
+    return lo;
+}
 
-        Mono * arr = malloc((count + 1) * sizeof(Mono));
-        if (arr == NULL)
-            exit(1);
-        Poly res = (Poly) {.size = count, .arr = arr};
-        int current_exp = monos_cpy[0].exp;
-        Poly current_poly = monos_cpy[0].p;
-        bool should_destroy = false;
-        unsigned int i = 1;
-        unsigned int k = 0;
+/**
+ * Dodaje dwa duże wielomiany, scalając ich jednomiany współbieżnie.
+ * Oba ciągi jednomianów są dzielone ścieżką scalania na części o równej
+ * łącznej długości, które są scalane w osobnych zadaniach wspólnej puli
+ * do rozłącznych fragmentów wyniku. Na koniec fragmenty są przesuwane tak,
+ * żeby usunąć miejsca po jednomianach, które się zredukowały.
+ * @param[in] p : wielomian @f$p@f$ niebędący współczynnikiem
+ * @param[in] q : wielomian @f$q@f$ niebędący współczynnikiem
+ * @return @f$p + q@f$
+ */
+static Poly PolyAddParallel(const Poly *p, const Poly *q) {
+    WorkPool *pool = PolyForkPool();
+    size_t n = p->size + q->size;
+    size_t parts = (size_t)WorkPoolThreads(pool) * ADD_PARALLEL_PARTS;
+    AddRange *ranges = malloc(parts * sizeof(AddRange));
+    if (ranges == NULL)
+        exit(1);
+    Poly res = {.size = n, .arr = MonosAlloc(n)};
+    const poly_exp_t *p_exps = MonosExps(p->arr);
+    const poly_exp_t *q_exps = MonosExps(q->arr);
 
-        while (i <= count) {
-            if (monos_cpy[i].exp != current_exp) {
-                Poly q = PolyClone(&current_poly);
-                if (should_destroy)
-                    PolyDestroy(&current_poly);
-                if (!(PolyIsZero(&q))) {
-                    res.arr[k] = (Mono) {.p = q, .exp = current_exp};
-                    k++;
-                }
-                current_poly = monos_cpy[i].p;
-                current_exp = monos_cpy[i].exp;
-                should_destroy = false;
-                i++;
-            }
-            else {
-                Poly q = PolyAdd(&current_poly, &monos_cpy[i].p);
-                if (should_destroy)
-                    PolyDestroy(&current_poly);
-                should_destroy = true;
-                current_poly = q;
-                i++;
-            }
+    WorkGroup g;
+    WorkGroupInit(&g, pool);
+    size_t i = 0;
+    size_t j = 0;
+    for (size_t t = 0; t < parts; t++) {
+        AddRange *r = &ranges[t];
+        *r = (AddRange) {.p = p, .q = q, .i = i, .j = j, .out = res.arr + i + j};
+        if (t + 1 < parts) {
+            r->i_end = PolyAddSplit(p_exps, p->size, q_exps, q->size,
+                                    n / parts * (t + 1), &r->j_end);
+        }
+        else {
+            r->i_end = p->size;
+            r->j_end = q->size;
         }
+        i = r->i_end;
+        j = r->j_end;
+        if (t + 1 < parts)
+            WorkGroupSpawn(&g, AddRangeRun, r);
+        else
+            AddRangeRun(r);
+    }
+    WorkGroupJoin(&g);
 
-        for (unsigned int j = 0; j <= count; j++)
-            PolyDestroy(&monos_cpy[j].p);
-        free(monos_cpy);
+    size_t k = 0;
+    for (size_t t = 0; t < parts; t++) {
+        memmove(res.arr + k, ranges[t].out, ranges[t].k * sizeof(Mono));
+        k += ranges[t].k;
+    }
+    free(ranges);
+    return PolyFinish(&res, k);
+}
+
+Poly PolyAdd(const Poly *p, const Poly *q) {
+    if (PolyIsZero(p))
+        return PolyClone(q);
+    if (PolyIsZero(q))
+        return PolyClone(p);
+    if (PolyIsCoeff(p))
+        return PolyAddCoeff(q, p->coeff);
+    if (PolyIsCoeff(q))
+        return PolyAddCoeff(p, q->coeff);
+    if (PolyIsDenseLeaf(p) && PolyIsDenseLeaf(q))
+        return PolyAddDense(p, q);
+    if (p->size + q->size >= ADD_PARALLEL_MIN_MONOS && PolyForkPool() != NULL)
+        return PolyAddParallel(p, q);
+
+    Poly res = {.size = p->size + q->size, .arr = MonosAlloc(p->size + q->size)};
+    size_t k = PolyAddMerge(p, 0, p->size, q, 0, q->size, res.arr);
+    return PolyFinish(&res, k);
+}
+
+/**
+ * Dodaje wyraz wolny do wielomianu.
+ * Przejmuje na własność zawartość struktury wskazywanej przez @p p.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] c : współczynnik
+ * @return @f$p + c@f$
+ */
+static Poly PolyAddCoeffOwned(Poly *p, poly_coeff_t c) {
+    if (PolyIsCoeff(p))
+        return PolyFromCoeff(p->coeff + c);
+    Poly q = *p;
+    if (c == 0)
+        return q;
+
+    size_t i = q.size - 1;
+    if (MonoGetExp(&q.arr[i]) != 0) {
+        if (MonosCapacity(q.arr) < q.size + 1)
+            q.arr = MonosResize(q.arr, q.size + 1);
+        q.arr[i + 1] = (Mono) {.p = PolyFromCoeff(c), .exp = 0};
+        q.size++;
+    }
+    else {
+        Poly r = PolyAddCoeffOwned(&q.arr[i].p, c);
+        if (PolyIsZero(&r))
+            q.size--;
+        else
+            q.arr[i].p = r;
+    }
+    if (q.size == 0) {
+        MonosFree(q.arr);
+        return PolyZero();
+    }
+    PolyUpdateInfo(&q);
+    return q;
+}
+
+Poly PolyAddOwned(Poly *p, Poly *q) {
+    if (PolyIsZero(p))
+        return *q;
+    if (PolyIsZero(q))
+        return *p;
+    // jednomiany argumentów są przenoszone do wyniku
+    PolyThaw(p);
+    PolyThaw(q);
+    if (PolyIsCoeff(p))
+        return PolyAddCoeffOwned(q, p->coeff);
+    if (PolyIsCoeff(q))
+        return PolyAddCoeffOwned(p, q->coeff);
+    if (PolyIsDenseLeaf(p) && PolyIsDenseLeaf(q)) {
+        Poly res = PolyAddDense(p, q);
+        MonosFree(p->arr);
+        MonosFree(q->arr);
+        return res;
+    }
 
-        if (k == 0) {
-            free(res.arr);
-            return PolyZero();
+    Poly res = {.size = p->size + q->size, .arr = MonosAlloc(p->size + q->size + 1)};
+    const poly_exp_t *p_exps = MonosExps(p->arr);
+    const poly_exp_t *q_exps = MonosExps(q->arr);
+    size_t i = 0;
+    size_t j = 0;
+    size_t k = 0;
+    while (i < p->size && j < q->size) {
+        poly_exp_t p_exp = p_exps[i];
+        poly_exp_t q_exp = q_exps[j];
+        if (p_exp > q_exp) {
+            size_t run = MonosCountAbove(p_exps + i, p->size - i, q_exp);
+            memcpy(&res.arr[k], &p->arr[i], run * sizeof(Mono));
+            i += run;
+            k += run;
+        }
+        else if (q_exp > p_exp) {
+            size_t run = MonosCountAbove(q_exps + j, q->size - j, p_exp);
+            memcpy(&res.arr[k], &q->arr[j], run * sizeof(Mono));
+            j += run;
+            k += run;
         }
+        else {
+            Poly sum = PolyAddOwned(&p->arr[i].p, &q->arr[j].p);
+            if (!PolyIsZero(&sum))
+                res.arr[k++] = (Mono) {.p = sum, .exp = p_exp};
+            i++;
+            j++;
+        }
+    }
+    while (i < p->size)
+        res.arr[k++] = p->arr[i++];
+    while (j < q->size)
+        res.arr[k++] = q->arr[j++];
+    MonosFree(p->arr);
+    MonosFree(q->arr);
+    return PolyFinish(&res, k);
+}
+
+/**
+ * Porównuje jednomiany pod względem wykładnika.
+ * @param[in] mm : jednomian
+ * @param[in] nn : jednomian
+ * @return liczba @f$k@f$: @f$k < 0@f$ jeśli deg @f$mm@f$ > deg @f$nn@f$,
+ * @f$k > 0@f$ jeśli deg @f$mm@f$ < deg @f$nn@f$,
+ * @f$k = 0@f$ jeśli deg @f$mm@f$ = deg @f$nn@f$.
+ */
+static int MonosCompare(const void * mm, const void * nn) {
+    Mono m = *(Mono*)mm;
+    Mono n = *(Mono*)nn;
+    return n.exp - m.exp;
+}
+
+/** Najmniejsza liczba jednomianów, od której stosowane jest sortowanie pozycyjne. */
+#define RADIX_SORT_MIN 64
 
-        if (k == 1 && res.arr[0].exp == 0 && PolyIsCoeff(&res.arr[0].p)) {
-            Poly r_coeff = PolyFromCoeff(res.arr[0].p.coeff);
-            free(res.arr);
-            return r_coeff;
+/** Liczba bitów cyfry w sortowaniu pozycyjnym. */
+#define RADIX_BITS 8
+
+/**
+ * Sortuje pozycyjnie (LSD) tablicę jednomianów o nieujemnych wykładnikach
+ * w kolejności malejących wykładników. Przebiegi dla cyfr, które są
+ * jednakowe we wszystkich wykładnikach, są pomijane.
+ * @param[in] monos : tablica jednomianów
+ * @param[in] count : liczba jednomianów
+ */
+static void MonosRadixSort(Mono *monos, size_t count) {
+    Mono *buf = malloc(count * sizeof(Mono));
+    if (buf == NULL)
+        exit(1);
+    Mono *src = monos;
+    Mono *dst = buf;
+    size_t counts[1 << RADIX_BITS];
+    for (unsigned shift = 0; shift < 32; shift += RADIX_BITS) {
+        for (size_t d = 0; d < (1 << RADIX_BITS); d++)
+            counts[d] = 0;
+        for (size_t i = 0; i < count; i++)
+            counts[((unsigned)src[i].exp >> shift) & ((1 << RADIX_BITS) - 1)]++;
+        if (counts[((unsigned)src[0].exp >> shift) & ((1 << RADIX_BITS) - 1)] == count)
+            continue;
+        // cyfry większe trafiają na początek tablicy
+        size_t pos = 0;
+        for (size_t d = (1 << RADIX_BITS); d-- > 0;) {
+            size_t c = counts[d];
+            counts[d] = pos;
+            pos += c;
         }
+        for (size_t i = 0; i < count; i++)
+            dst[counts[((unsigned)src[i].exp >> shift) & ((1 << RADIX_BITS) - 1)]++] = src[i];
+        Mono *t = src;
+        src = dst;
+        dst = t;
+    }
+    if (src != monos)
+        memcpy(monos, src, count * sizeof(Mono));
+    free(buf);
+}
+
+/**
+ * Sortuje tablicę jednomianów pod względem wykładników.
+ * Tablice już posortowane i posortowane odwrotnie (np. wczytane z wypisanego
+ * wielomianu) są rozpoznawane w czasie liniowym. Duże tablice są sortowane
+ * pozycyjnie, a małe przez qsort.
+ * @param[in] monos : tablica jednomianów
+ * @param[in] count : liczba jednomianów
+ */
+static void MonosSortRuns(Mono* monos, size_t count) {
+    bool descending = true;
+    bool ascending = true;
+    bool negative = false;
+    for (size_t i = 0; i < count; i++) {
+        if (i > 0 && monos[i - 1].exp < monos[i].exp)
+            descending = false;
+        if (i > 0 && monos[i - 1].exp > monos[i].exp)
+            ascending = false;
+        if (monos[i].exp < 0)
+            negative = true;
+    }
+    if (descending)
+        return;
+    if (ascending) {
+        for (size_t i = 0, j = count - 1; i < j; i++, j--) {
+            Mono t = monos[i];
+            monos[i] = monos[j];
+            monos[j] = t;
+        }
+        return;
+    }
+    if (count >= RADIX_SORT_MIN && !negative)
+        MonosRadixSort(monos, count);
+    else
+        qsort(monos, count, sizeof(Mono), MonosCompare);
+}
 
-        res.size = k;
-        res.arr = realloc(res.arr, (k + 1) * sizeof (Mono));
-        res = PolySimplify(&res);
+/**
+ * Sortuje tablicę jednomianów pod względem wykładników, zapisując
+ * zdarzenie śledzenia dla dużych tablic.
+ * @param[in] monos : tablica jednomianów
+ * @param[in] count : liczba jednomianów
+ */
+void MonosSort(Mono* monos, size_t count) {
+    uint64_t start = count >= TRACE_MIN_MONOS ? TraceBegin() : 0;
+    MonosSortRuns(monos, count);
+    TraceEnd("sort", start, count, 0);
+}
+
+Poly PolyAddMonos(size_t count, const Mono monos[]) {
+    if (count == 0)
+        return PolyZero();
+    if (count == 1) {
+        Mono * arr = MonosAlloc(2);
+        arr[0] = monos[0];
+        Poly p = (Poly) {.size = 1, .arr = arr};
+        PolyUpdateInfo(&p);
+        p = PolySimplify(&p);
+        return p;
+    }
+    else {
+        uint64_t start = count >= TRACE_MIN_MONOS ? TraceBegin() : 0;
+        Mono * monos_cpy = malloc((count + 1) * sizeof(Mono));
+        if (monos_cpy == NULL)
+            exit(1);
+        for (unsigned int i = 0; i < count; i++) {
+            monos_cpy[i] = monos[i];
+        }
+        MonosSort(monos_cpy, count);
+        monos_cpy[count] = (Mono) {.p = PolyZero(), .exp = -1};
+
+        Mono * arr = MonosAlloc(count + 1);
+        Poly res = (Poly) {.size = count, .arr = arr};
+        unsigned int i = 0;
+        unsigned int k = 0;
+
+        while (i < count) {
+            int current_exp = monos_cpy[i].exp;
+            Poly q = monos_cpy[i].p;
+            i++;
+            if (monos_cpy[i].exp == current_exp) {
+                PolyAccumulator acc;
+                PolyAccInit(&acc);
+                PolyAccAddPoly(&acc, &q);
+                while (monos_cpy[i].exp == current_exp) {
+                    PolyAccAddPoly(&acc, &monos_cpy[i].p);
+                    i++;
+                }
+                q = PolyAccFinish(&acc);
+            }
+            if (!(PolyIsZero(&q))) {
+                res.arr[k] = (Mono) {.p = q, .exp = current_exp};
+                k++;
+            }
+        }
+        free(monos_cpy);
+
+        res = PolyFinish(&res, k);
+        TraceEnd("merge", start, count, k);
         return res;
     }
 }
@@ -300,10 +1068,17 @@ Poly PolyMulByCoeff(const Poly *p, poly_coeff_t c) {
         return PolyClone(p);
     if (PolyIsCoeff(p))
         return PolyFromCoeff((p->coeff * c));
+    if (PolyIsDenseLeaf(p)) {
+        size_t n = MonosGetHeader(p->arr)->deg_by[0] + 1;
+        uint64_t *d = PolyToDense(p, n);
+        if (c == -1)
+            DenseNeg(d, n);
+        else
+            DenseScale(d, n, (uint64_t)c);
+        return PolyFromDense(d, n);
+    }
 
-    Mono * arr = malloc((p->size + 1) * sizeof(Mono));
-    if (arr == NULL)
-        exit(1);
+    Mono * arr = MonosAlloc(p->size + 1);
     Poly res = (Poly) {.size = p->size, .arr = arr};
     int k = 0;
     for (unsigned int i = 0; i < p->size; i++) {
@@ -316,16 +1091,17 @@ Poly PolyMulByCoeff(const Poly *p, poly_coeff_t c) {
     }
 
     if (k == 0) {
-        free(res.arr);
+        MonosFree(res.arr);
         return PolyZero();
     }
     if (k == 1 && res.arr[0].exp == 0 && PolyIsCoeff(&res.arr[0].p)) {
         Poly r_coeff = PolyFromCoeff(res.arr[0].p.coeff);
-        free(res.arr);
+        MonosFree(res.arr);
         return r_coeff;
     }
     res.size = k;
-    res.arr = realloc(res.arr, (k + 1) * sizeof (Mono));
+    res.arr = MonosResize(res.arr, k + 1);
+    PolyUpdateInfo(&res);
     return res;
 }
 
@@ -338,25 +1114,131 @@ Poly PolyMul(const Poly *p, const Poly *q) {
     if (PolyIsCoeff(q))
         return PolyMulByCoeff(p, q->coeff);
 
-    Mono * arr = malloc((p->size * q->size + 1) * sizeof(Mono));
-    if (arr == NULL)
-        exit(1);
-    int k = 0;
+    size_t a = MonosOfPoly(p);
+    size_t b = MonosOfPoly(q);
+    uint64_t start = a + b >= TRACE_MIN_MONOS ? TraceBegin() : 0;
+    PolyAccumulator acc;
+    PolyAccInit(&acc);
+    PolyAccAddMul(&acc, p, q);
+    Poly res = PolyAccFinish(&acc);
+    TraceEnd("mul", start, a, b);
+    return res;
+}
 
-    for (unsigned int i = 0; i < p->size; i++) {
+void PolyMulAdd(const Poly *p, const Poly *q, Poly *acc) {
+    PolyAccumulator sum;
+    PolyAccInit(&sum);
+    PolyAccAddPoly(&sum, acc);
+    PolyAccAddMul(&sum, p, q);
+    *acc = PolyAccFinish(&sum);
+}
+
+void PolyAccAddMul(PolyAccumulator *acc, const Poly *p, const Poly *q) {
+    if (PolyIsZero(p) || PolyIsZero(q))
+        return;
+    if (PolyIsCoeff(p) || PolyIsCoeff(q)) {
+        Poly r = PolyIsCoeff(p) ? PolyMulByCoeff(q, p->coeff) : PolyMulByCoeff(p, q->coeff);
+        PolyAccAddPoly(acc, &r);
+        return;
+    }
+    if (PolyIsDenseLeaf(p) && PolyIsDenseLeaf(q)) {
+        size_t np = MonosGetHeader(p->arr)->deg_by[0] + 1;
+        size_t nq = MonosGetHeader(q->arr)->deg_by[0] + 1;
+        uint64_t *a = PolyToDense(p, np);
+        uint64_t *b = PolyToDense(q, nq);
+        uint64_t *c = calloc(np + nq - 1, sizeof(uint64_t));
+        if (c == NULL)
+            exit(1);
+        DenseConvolve(c, a, np, b, nq);
+        free(a);
+        free(b);
+        Poly r = PolyFromDense(c, np + nq - 1);
+        PolyAccAddPoly(acc, &r);
+        return;
+    }
+
+    // iloczyn jednomianu z p i wielomianu q ma jednomiany już posortowane,
+    // więc kolejne takie wiersze są od razu sumowane w akumulatorze;
+    // po przekroczeniu budżetu pamięci lub czasu wynik i tak zostanie odrzucony
+    for (unsigned int i = 0; i < p->size && !MonosBudgetStop(); i++) {
+        Poly row = {.size = q->size, .arr = MonosAlloc(q->size + 1)};
+        size_t k = 0;
         for (unsigned int j = 0; j < q->size; j++) {
             Poly r = PolyMul(&p->arr[i].p, &q->arr[j].p);
             if (!PolyIsZero(&r)) {
-                arr[k].p = r;
-                arr[k].exp = p->arr[i].exp + q->arr[j].exp;
+                row.arr[k].p = r;
+                row.arr[k].exp = p->arr[i].exp + q->arr[j].exp;
                 k++;
             }
         }
+        row = PolyFinish(&row, k);
+        PolyAccAddPoly(acc, &row);
     }
-    Poly res = PolyAddMonos(k, arr);
-    free(arr);
-    res = PolySimplify(&res);
-    return res;
+}
+
+/**
+ * Mnoży dwa wielomiany ze zmiennej @f$x_{var}@f$, pomijając jednomiany
+ * iloczynu przekraczające ograniczenia stopni.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @param[in] deg : największy stopień jednomianów wyniku
+ * @param[in] var : numer zmiennej, której wykładniki są w tablicach @p p i @p q
+ * @param[in] count : liczba ograniczanych zmiennych
+ * @param[in] var_deg : największe stopnie wyniku ze względu na kolejne zmienne
+ * @return obcięty iloczyn @f$p * q@f$
+ */
+static Poly PolyMulTruncRec(const Poly *p, const Poly *q, poly_exp_t deg, size_t var,
+                            size_t count, const poly_exp_t var_deg[]) {
+    if (deg < 0 || PolyIsZero(p) || PolyIsZero(q))
+        return PolyZero();
+    if (PolyIsCoeff(p) && PolyIsCoeff(q))
+        return PolyFromCoeff(p->coeff * q->coeff);
+    if (var >= count && (long)PolyDeg(p) + PolyDeg(q) <= deg)
+        return PolyMul(p, q);
+
+    poly_exp_t bound = deg;
+    if (var < count && var_deg[var] < bound)
+        bound = var_deg[var];
+
+    // współczynnik traktujemy jak wielomian z jednym jednomianem x^0
+    Mono p_coeff = {.p = *p, .exp = 0};
+    Mono q_coeff = {.p = *q, .exp = 0};
+    const Mono *p_arr = PolyIsCoeff(p) ? &p_coeff : p->arr;
+    const Mono *q_arr = PolyIsCoeff(q) ? &q_coeff : q->arr;
+    size_t p_size = PolyIsCoeff(p) ? 1 : p->size;
+    size_t q_size = PolyIsCoeff(q) ? 1 : q->size;
+
+    PolyAccumulator acc;
+    PolyAccInit(&acc);
+    for (size_t i = p_size; i-- > 0 && !MonosBudgetStop();) {
+        poly_exp_t p_exp = p_arr[i].exp;
+        if (p_exp > bound)
+            break;
+        // wykładniki q maleją, więc pomijamy prefiks przekraczający ograniczenie
+        size_t j = PolyIsCoeff(q) ? 0 : MonosCountAbove(MonosExps(q_arr), q_size, bound - p_exp);
+        if (j == q_size)
+            continue;
+        Poly row = {.size = q_size - j, .arr = MonosAlloc(q_size - j + 1)};
+        size_t k = 0;
+        for (; j < q_size; j++) {
+            poly_exp_t e = p_exp + q_arr[j].exp;
+            Poly r = PolyMulTruncRec(&p_arr[i].p, &q_arr[j].p, deg - e, var + 1, count, var_deg);
+            if (!PolyIsZero(&r))
+                row.arr[k++] = (Mono) {.p = r, .exp = e};
+        }
+        row = PolyFinish(&row, k);
+        PolyAccAddPoly(&acc, &row);
+    }
+    return PolyAccFinish(&acc);
+}
+
+Poly PolyMulTrunc(const Poly *p, const Poly *q, poly_exp_t deg) {
+    return PolyMulTruncRec(p, q, deg, 0, 0, NULL);
+}
+
+Poly PolyMulTruncVars(const Poly *p, const Poly *q, poly_exp_t deg,
+                      size_t count, const poly_exp_t var_deg[]) {
+    return PolyMulTruncRec(p, q, deg, 0, count, var_deg);
 }
 
 Poly PolyNeg(const Poly *p) {
@@ -371,18 +1253,236 @@ Poly PolySub(const Poly *p, const Poly *q) {
 }
 
 /**
- * Zwraca maksimum dwóch współczynników.
- * @param[in] a : wartość współczynnika
- * @param[in] b : wartość współczynnika
- * @return @f$max(a, b)@f$
+ * Struktura przechowująca kursor scalania k-wielomianów: pozycję
+ * w tablicy jednomianów jednego z sumowanych wielomianów.
  */
-poly_exp_t max(poly_exp_t a, poly_exp_t b) {
-    if (a < b)
-        return b;
-    return a;
+typedef struct MergeCursor {
+    poly_exp_t exp; ///< wykładnik jednomianu wskazywanego przez kursor
+    size_t idx;     ///< numer wielomianu
+    size_t pos;     ///< pozycja w tablicy jednomianów
+} MergeCursor;
+
+/**
+ * Przywraca własność kopca (maksimum wykładnika w korzeniu) w poddrzewie.
+ * @param[in] heap : kopiec kursorów
+ * @param[in] n : liczba kursorów w kopcu
+ * @param[in] i : korzeń poddrzewa
+ */
+static void MergeHeapSiftDown(MergeCursor *heap, size_t n, size_t i) {
+    MergeCursor c = heap[i];
+    while (2 * i + 1 < n) {
+        size_t j = 2 * i + 1;
+        if (j + 1 < n && heap[j + 1].exp > heap[j].exp)
+            j++;
+        if (heap[j].exp <= c.exp)
+            break;
+        heap[i] = heap[j];
+        i = j;
+    }
+    heap[i] = c;
 }
 
-poly_exp_t PolyDegBy(const Poly *p, size_t var_idx) {
+/**
+ * Sumuje wielomiany, scalając jednocześnie ich tablice jednomianów.
+ * Jednomiany o równych wykładnikach są sumowane rekurencyjnie tą samą
+ * metodą, więc każdy jednomian jest kopiowany co najwyżej raz.
+ * @param[in] count : liczba wielomianów
+ * @param[in] polys : tablica wskaźników na wielomiany
+ * @return suma wielomianów
+ */
+static Poly PolyAddPtrs(size_t count, const Poly *polys[]) {
+    if (count == 0)
+        return PolyZero();
+    if (count == 1)
+        return PolyClone(polys[0]);
+    if (count == 2)
+        return PolyAdd(polys[0], polys[1]);
+
+    poly_coeff_t c = 0;
+    size_t nodes = 0;
+    size_t total = 1;
+    MergeCursor *heap = malloc(count * sizeof(MergeCursor));
+    const Poly **group = malloc((count + 1) * sizeof(Poly *));
+    if (heap == NULL || group == NULL)
+        exit(1);
+    for (size_t i = 0; i < count; i++) {
+        if (PolyIsCoeff(polys[i])) {
+            c += polys[i]->coeff;
+        }
+        else {
+            heap[nodes++] = (MergeCursor) {.exp = MonosExps(polys[i]->arr)[0], .idx = i, .pos = 0};
+            total += polys[i]->size;
+        }
+    }
+    if (nodes <= 1) {
+        Poly res = nodes == 0 ? PolyFromCoeff(c) : PolyAddCoeff(polys[heap[0].idx], c);
+        free(heap);
+        free(group);
+        return res;
+    }
+    for (size_t i = nodes / 2; i-- > 0;)
+        MergeHeapSiftDown(heap, nodes, i);
+
+    Poly coeff = PolyFromCoeff(c);
+    Poly res = {.size = total, .arr = MonosAlloc(total)};
+    size_t k = 0;
+    while (nodes > 0) {
+        poly_exp_t e = heap[0].exp;
+        size_t g = 0;
+        while (nodes > 0 && heap[0].exp == e) {
+            const Poly *p = polys[heap[0].idx];
+            group[g++] = &p->arr[heap[0].pos].p;
+            if (++heap[0].pos < p->size)
+                heap[0].exp = MonosExps(p->arr)[heap[0].pos];
+            else
+                heap[0] = heap[--nodes];
+            MergeHeapSiftDown(heap, nodes, 0);
+        }
+        if (e == 0 && c != 0) {
+            group[g++] = &coeff;
+            c = 0;
+        }
+        Poly sum = PolyAddPtrs(g, group);
+        if (!PolyIsZero(&sum))
+            res.arr[k++] = (Mono) {.p = sum, .exp = e};
+    }
+    if (c != 0)
+        res.arr[k++] = (Mono) {.p = coeff, .exp = 0};
+    free(heap);
+    free(group);
+
+    return PolyFinish(&res, k);
+}
+
+Poly PolyAddMany(size_t count, const Poly polys[]) {
+    const Poly **ptrs = malloc((count + 1) * sizeof(Poly *));
+    if (ptrs == NULL)
+        exit(1);
+    for (size_t i = 0; i < count; i++)
+        ptrs[i] = &polys[i];
+    Poly res = PolyAddPtrs(count, ptrs);
+    free(ptrs);
+    return res;
+}
+
+/** Najmniejsza łączna liczba jednomianów, od której poddrzewa iloczynu
+ * są liczone w osobnych wątkach. */
+#define MUL_PARALLEL_MIN_MONOS 64
+
+/**
+ * Struktura przechowująca zadanie policzenia iloczynu fragmentu tablicy
+ * wielomianów.
+ */
+typedef struct MulRangeTask {
+    const Poly *polys; ///< tablica mnożonych wielomianów
+    size_t count;      ///< liczba mnożonych wielomianów
+    unsigned depth;    ///< głębokość zadania w drzewie iloczynu
+    unsigned max_depth; ///< największa głębokość zadań liczonych w osobnych wątkach
+    Poly res;          ///< iloczyn
+} MulRangeTask;
+
+/**
+ * Daje największą głębokość drzewa iloczynu, na której zadania są
+ * jeszcze uruchamiane w osobnych wątkach.
+ * @return głębokość
+ */
+static unsigned MulParallelDepth(void) {
+    WorkPool *pool = PolyForkPool();
+    unsigned threads = pool != NULL ? WorkPoolThreads(pool) : 1;
+    unsigned depth = 0;
+    while (threads > 1) {
+        depth++;
+        threads = (threads + 1) / 2;
+    }
+    return depth;
+}
+
+static void MulRangeRun(void *arg);
+
+/**
+ * Mnoży wielomiany z fragmentu tablicy, budując zrównoważone drzewo
+ * iloczynów. Niezależne poddrzewa są liczone współbieżnie.
+ * @param[in] t : zadanie
+ */
+static void MulRange(MulRangeTask *t) {
+    if (t->count == 1) {
+        t->res = PolyClone(&t->polys[0]);
+        return;
+    }
+    size_t half = t->count / 2;
+    MulRangeTask left = {.polys = t->polys, .count = half, .depth = t->depth + 1,
+                         .max_depth = t->max_depth};
+    MulRangeTask right = {.polys = t->polys + half, .count = t->count - half,
+                          .depth = t->depth + 1, .max_depth = t->max_depth};
+    size_t monos = 0;
+    for (size_t i = 0; i < t->count; i++)
+        if (!PolyIsCoeff(&t->polys[i]))
+            monos += t->polys[i].size;
+
+    WorkGroup g;
+    bool parallel = t->depth < t->max_depth && monos >= MUL_PARALLEL_MIN_MONOS;
+    if (parallel) {
+        WorkGroupInit(&g, PolyForkPool());
+        WorkGroupSpawn(&g, MulRangeRun, &left);
+    }
+    else {
+        MulRange(&left);
+    }
+    MulRange(&right);
+    if (parallel)
+        WorkGroupJoin(&g);
+
+    t->res = PolyMul(&left.res, &right.res);
+    PolyDestroy(&left.res);
+    PolyDestroy(&right.res);
+}
+
+/**
+ * Wykonuje zadanie mnożenia jako zadanie puli.
+ * @param[in] arg : zadanie
+ */
+static void MulRangeRun(void *arg) {
+    MulRange(arg);
+}
+
+Poly PolyMulMany(size_t count, const Poly polys[]) {
+    if (count == 0)
+        return PolyFromCoeff(1);
+    MulRangeTask t = {.polys = polys, .count = count, .depth = 0,
+                      .max_depth = MulParallelDepth()};
+    MulRange(&t);
+    return t.res;
+}
+
+static poly_exp_t PolyDegByAt(const Poly *p, size_t var_idx, unsigned depth);
+
+/**
+ * Struktura przechowująca dane współbieżnego liczenia stopnia.
+ */
+typedef struct DegByFork {
+    size_t var_idx;   ///< numer zmiennej we współczynnikach
+    poly_exp_t *degs; ///< stopnie kolejnych współczynników
+} DegByFork;
+
+/**
+ * Liczy stopień współczynnika ze względu na zmienną.
+ * @param[in] f : operacja (ctx to DegByFork)
+ * @param[in] i : numer jednomianu
+ */
+static void PolyDegByChild(const PolyFork *f, size_t i) {
+    DegByFork *d = f->ctx;
+    d->degs[i] = PolyDegByAt(&f->p->arr[i].p, d->var_idx, f->depth + 1);
+}
+
+/**
+ * Zwraca stopień wielomianu ze względu na zadaną zmienną, licząc stopnie
+ * dużych poddrzew współbieżnie.
+ * @param[in] p : wielomian
+ * @param[in] var_idx : indeks zmiennej
+ * @param[in] depth : głębokość zagnieżdżenia zadań
+ * @return stopień wielomianu @p p z względu na zmienną o indeksie @p var_idx
+ */
+static poly_exp_t PolyDegByAt(const Poly *p, size_t var_idx, unsigned depth) {
     if (PolyIsZero(p))
         return -1;
     if (var_idx == 0) {
@@ -392,39 +1492,255 @@ poly_exp_t PolyDegBy(const Poly *p, size_t var_idx) {
     }
     if (PolyIsCoeff(p))
         return 0; //
+    if (var_idx < MONOS_DEG_VARS)
+        return MonosGetHeader(p->arr)->deg_by[var_idx];
 
     poly_exp_t deg = -1;
-    for (unsigned int i = 0; i < p->size; i++)
-        deg = max(deg, PolyDegBy(&p->arr[i].p, var_idx - 1));
+    if (PolyForkWorth(p, depth)) {
+        DegByFork d = {.var_idx = var_idx - 1, .degs = malloc(p->size * sizeof(poly_exp_t))};
+        if (d.degs == NULL)
+            exit(1);
+        PolyFork f = {.p = p, .depth = depth, .fn = PolyDegByChild, .ctx = &d};
+        PolyForkEach(&f);
+        for (size_t i = 0; i < p->size; i++)
+            deg = max(deg, d.degs[i]);
+        free(d.degs);
+        return deg;
+    }
+    PolyWalk w;
+    PolyWalkInit(&w);
+    PolyWalkPush(&w, p, NULL, NULL);
+    while (!PolyWalkIsEmpty(&w)) {
+        PolyWalkFrame *f = PolyWalkTop(&w);
+        if (f->i < f->p->size) {
+            const Poly *c = &f->p->arr[f->i++].p;
+            size_t c_var_idx = var_idx - w.size;
+            if (PolyIsCoeff(c))
+                deg = max(deg, PolyIsZero(c) ? -1 : 0);
+            else if (c_var_idx < MONOS_DEG_VARS)
+                deg = max(deg, MonosGetHeader(c->arr)->deg_by[c_var_idx]);
+            else
+                PolyWalkPush(&w, c, NULL, NULL);
+        }
+        else {
+            PolyWalkPop(&w);
+        }
+    }
+    PolyWalkFree(&w);
     return deg;
 }
 
+poly_exp_t PolyDegBy(const Poly *p, size_t var_idx) {
+    return PolyDegByAt(p, var_idx, 0);
+}
+
 poly_exp_t PolyDeg(const Poly *p) {
     if (PolyIsZero(p))
         return -1;
     if (PolyIsCoeff(p))
         return 0;
+    return MonosGetHeader(p->arr)->deg;
+}
 
-    poly_exp_t deg = 0;
-    for (unsigned int i = 0; i < p->size; i++) {
-        deg = max(deg, PolyDeg(&p->arr[i].p) + p->arr[i].exp);
+/**
+ * Miesza wartość do skrótu.
+ * @param[in] h : dotychczasowy skrót
+ * @param[in] v : wartość
+ * @return nowy skrót
+ */
+static uint64_t HashMix(uint64_t h, uint64_t v) {
+    h ^= v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+    h ^= h >> 31;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 29;
+    return h;
+}
+
+/**
+ * Daje skrót zapamiętany w nagłówku węzła.
+ * @param[in] p : wielomian niebędący współczynnikiem
+ * @return skrót lub 0, jeśli nie został wyliczony
+ */
+static uint64_t PolyStoredHash(const Poly *p) {
+    return atomic_load_explicit(&MonosGetHeader(p->arr)->hash, memory_order_relaxed);
+}
+
+static uint64_t PolyHashNode(const Poly *p);
+
+/**
+ * Daje skrót współczynnika. Zamrożony węzeł bez zapamiętanego skrótu
+ * pochodzi z punktu kontrolnego zapisanego przez starszą wersję programu;
+ * jego skrót jest liczony bez zapisywania.
+ * @param[in] c : współczynnik
+ * @return skrót współczynnika
+ */
+static uint64_t PolyHashOf(const Poly *c) {
+    if (PolyIsCoeff(c))
+        return HashMix(0, (uint64_t)c->coeff);
+    uint64_t hash = PolyStoredHash(c);
+    return hash != 0 ? hash : PolyHashNode(c);
+}
+
+/**
+ * Liczy skrót węzła wielomianu ze skrótów jego współczynników.
+ * Skróty współczynników niezamrożonych muszą być już wyliczone.
+ * @param[in] p : wielomian niebędący współczynnikiem
+ * @return skrót wielomianu
+ */
+static uint64_t PolyHashNode(const Poly *p) {
+    uint64_t hash = HashMix(1, p->size);
+    for (size_t i = 0; i < p->size; i++) {
+        hash = HashMix(hash, (uint64_t)p->arr[i].exp);
+        hash = HashMix(hash, PolyHashOf(&p->arr[i].p));
     }
-    return deg;
+    return hash != 0 ? hash : 1;
 }
 
-bool PolyIsEq(const Poly *p, const Poly *q) {
+/**
+ * Liczy skrót węzła i zapamiętuje go, jeśli węzeł nie jest zamrożony.
+ * @param[in] p : wielomian niebędący współczynnikiem
+ * @return skrót wielomianu
+ */
+static uint64_t PolyStoreHash(const Poly *p) {
+    uint64_t hash = PolyHashNode(p);
+    if (!MonosIsFrozen(p->arr))
+        atomic_store_explicit(&MonosGetHeader(p->arr)->hash, hash, memory_order_relaxed);
+    return hash;
+}
+
+static uint64_t PolyHashAt(const Poly *p, unsigned depth);
+
+/**
+ * Liczy skrót współczynnika, jeśli nie jest jeszcze wyliczony.
+ * @param[in] f : operacja
+ * @param[in] i : numer jednomianu
+ */
+static void PolyHashChild(const PolyFork *f, size_t i) {
+    PolyHashAt(&f->p->arr[i].p, f->depth + 1);
+}
+
+/**
+ * Liczy skrót wielomianu, licząc skróty dużych poddrzew współbieżnie.
+ * @param[in] p : wielomian
+ * @param[in] depth : głębokość zagnieżdżenia zadań
+ * @return skrót wielomianu
+ */
+static uint64_t PolyHashAt(const Poly *p, unsigned depth) {
+    if (PolyIsCoeff(p))
+        return HashMix(0, (uint64_t)p->coeff);
+    if (PolyStoredHash(p) != 0)
+        return PolyStoredHash(p);
+    if (MonosIsFrozen(p->arr))
+        return PolyHashNode(p);
+    if (PolyForkWorth(p, depth)) {
+        PolyFork f = {.p = p, .depth = depth, .fn = PolyHashChild};
+        PolyForkEach(&f);
+        return PolyStoreHash(p);
+    }
+
+    PolyWalk w;
+    PolyWalkInit(&w);
+    PolyWalkPush(&w, p, NULL, NULL);
+    while (!PolyWalkIsEmpty(&w)) {
+        PolyWalkFrame *f = PolyWalkTop(&w);
+        if (f->i < f->p->size) {
+            const Poly *c = &f->p->arr[f->i++].p;
+            if (!PolyIsCoeff(c) && PolyStoredHash(c) == 0 && !MonosIsFrozen(c->arr))
+                PolyWalkPush(&w, c, NULL, NULL);
+        }
+        else {
+            PolyStoreHash(f->p);
+            PolyWalkPop(&w);
+        }
+    }
+    PolyWalkFree(&w);
+    return PolyStoredHash(p);
+}
+
+uint64_t PolyHash(const Poly *p) {
+    return PolyHashAt(p, 0);
+}
+
+static bool PolyIsEqAt(const Poly *p, const Poly *q, unsigned depth);
+
+/**
+ * Struktura przechowująca dane współbieżnego porównywania wielomianów.
+ */
+typedef struct IsEqFork {
+    const Poly *q; ///< drugi wielomian
+    bool *eqs;     ///< wyniki porównań kolejnych współczynników
+} IsEqFork;
+
+/**
+ * Porównuje współczynniki jednomianów o tym samym numerze.
+ * @param[in] f : operacja (ctx to IsEqFork)
+ * @param[in] i : numer jednomianu
+ */
+static void PolyIsEqChild(const PolyFork *f, size_t i) {
+    IsEqFork *e = f->ctx;
+    e->eqs[i] = PolyIsEqAt(&f->p->arr[i].p, &e->q->arr[i].p, f->depth + 1);
+}
+
+/**
+ * Sprawdza równość dwóch wielomianów, porównując duże poddrzewa
+ * współbieżnie.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @param[in] depth : głębokość zagnieżdżenia zadań
+ * @return @f$p = q@f$
+ */
+static bool PolyIsEqAt(const Poly *p, const Poly *q, unsigned depth) {
     if (PolyIsCoeff(p) != PolyIsCoeff(q))
         return false;
     if (PolyIsCoeff(p) && PolyIsCoeff(q))
         return p->coeff == q->coeff;
-    if (p->size != q->size)
+    if (p->size != q->size || PolyHashAt(p, depth) != PolyHashAt(q, depth)
+        || memcmp(MonosExps(p->arr), MonosExps(q->arr), p->size * sizeof(poly_exp_t)) != 0)
         return false;
 
-    for (unsigned int i = 0; i < p->size; i++) {
-        if (!PolyIsEq(&p->arr[i].p, &q->arr[i].p) || p->arr[i].exp != q->arr[i].exp)
-            return false;
+    bool eq = true;
+    if (PolyForkWorth(p, depth)) {
+        // wykładniki są już porównane
+        IsEqFork e = {.q = q, .eqs = malloc(p->size * sizeof(bool))};
+        if (e.eqs == NULL)
+            exit(1);
+        PolyFork f = {.p = p, .depth = depth, .fn = PolyIsEqChild, .ctx = &e};
+        PolyForkEach(&f);
+        for (size_t i = 0; i < p->size; i++)
+            eq = eq && e.eqs[i];
+        free(e.eqs);
+        return eq;
     }
-    return true;
+    PolyWalk w;
+    PolyWalkInit(&w);
+    PolyWalkPush(&w, p, q, NULL);
+    while (eq && !PolyWalkIsEmpty(&w)) {
+        PolyWalkFrame *f = PolyWalkTop(&w);
+        if (f->i < f->p->size) {
+            const Mono *m = &f->p->arr[f->i];
+            const Mono *n = &f->q->arr[f->i];
+            f->i++;
+            if (m->exp != n->exp || PolyIsCoeff(&m->p) != PolyIsCoeff(&n->p))
+                eq = false;
+            else if (PolyIsCoeff(&m->p))
+                eq = m->p.coeff == n->p.coeff;
+            else if (m->p.size != n->p.size || PolyHash(&m->p) != PolyHash(&n->p)
+                     || memcmp(MonosExps(m->p.arr), MonosExps(n->p.arr),
+                               m->p.size * sizeof(poly_exp_t)) != 0)
+                eq = false;
+            else
+                PolyWalkPush(&w, &m->p, &n->p, NULL);
+        }
+        else {
+            PolyWalkPop(&w);
+        }
+    }
+    PolyWalkFree(&w);
+    return eq;
+}
+
+bool PolyIsEq(const Poly *p, const Poly *q) {
+    return PolyIsEqAt(p, q, 0);
 }
 
 /**
@@ -442,26 +1758,460 @@ poly_coeff_t Expo(poly_coeff_t x, poly_exp_t n) {
     return t;
 }
 
+/**
+ * Struktura przechowująca dane współbieżnego wartościowania wielomianu.
+ */
+typedef struct AtFork {
+    poly_coeff_t x; ///< wartość zmiennej
+    Poly *terms;    ///< kolejne współczynniki przemnożone przez potęgi x
+} AtFork;
+
+/**
+ * Mnoży współczynnik jednomianu przez odpowiednią potęgę x.
+ * @param[in] f : operacja (ctx to AtFork)
+ * @param[in] i : numer jednomianu
+ */
+static void PolyAtChild(const PolyFork *f, size_t i) {
+    AtFork *a = f->ctx;
+    const Mono *m = &f->p->arr[i];
+    a->terms[i] = PolyMulByCoeff(&m->p, Expo(a->x, m->exp));
+}
+
 Poly PolyAt(const Poly *p, poly_coeff_t x) {
     if (PolyIsCoeff(p)) {
         Poly q = PolyClone(p);
         return q;
     }
-    poly_coeff_t c = Expo(x, p->arr[0].exp);
-    Poly q = PolyMulByCoeff(&p->arr[0].p, c);
-    Poly s;
-    Poly r;
-    for (unsigned int i = 1; i < p->size; i++) {
-        c = Expo(x, p->arr[i].exp);
-        r = PolyMulByCoeff(&p->arr[i].p, c);
-        s = PolyAdd(&q, &r);
-        PolyDestroy(&q);
-        PolyDestroy(&r);
-        q = s;
+    PolyAccumulator acc;
+    PolyAccInit(&acc);
+    if (PolyForkWorth(p, 0)) {
+        // składniki są sumowane po kolei, więc wynik nie zależy od
+        // kolejności ich wyliczenia
+        AtFork a = {.x = x, .terms = malloc(p->size * sizeof(Poly))};
+        if (a.terms == NULL)
+            exit(1);
+        PolyFork f = {.p = p, .depth = 0, .fn = PolyAtChild, .ctx = &a};
+        PolyForkEach(&f);
+        for (size_t i = 0; i < p->size; i++)
+            PolyAccAddPoly(&acc, &a.terms[i]);
+        free(a.terms);
+        return PolyAccFinish(&acc);
     }
+    for (unsigned int i = 0; i < p->size && !MonosBudgetStop(); i++) {
+        poly_coeff_t c = Expo(x, p->arr[i].exp);
+        Poly r = PolyMulByCoeff(&p->arr[i].p, c);
+        PolyAccAddPoly(&acc, &r);
+    }
+    return PolyAccFinish(&acc);
+}
+
+/**
+ * Struktura przechowująca wyrazy wielomianu rozpisane do ustalonej
+ * głębokości: dla każdego wyrazu wykładniki kolejnych zmiennych
+ * i wielomian będący jego współczynnikiem na tej głębokości.
+ */
+typedef struct PermTerms {
+    size_t count;      ///< liczba zmiennych (długość wektora wykładników)
+    size_t size;       ///< liczba wyrazów
+    size_t capacity;   ///< pojemność tablic
+    poly_exp_t *exps;  ///< wektory wykładników, po @p count na wyraz
+    const Poly **rest; ///< współczynniki wyrazów
+} PermTerms;
+
+/**
+ * Dopisuje wyraz, zmieniając kolejność jego wykładników.
+ * @param[in] t : wyrazy
+ * @param[in] path : wykładniki kolejnych zmiennych (brakujące są zerami)
+ * @param[in] perm : permutacja zmiennych
+ * @param[in] rest : współczynnik wyrazu
+ */
+static void PermTermsPush(PermTerms *t, const poly_exp_t *path, const size_t perm[],
+                          const Poly *rest) {
+    if (t->size == t->capacity) {
+        t->capacity = t->capacity == 0 ? 16 : 2 * t->capacity;
+        t->exps = realloc(t->exps, t->capacity * t->count * sizeof(poly_exp_t));
+        t->rest = realloc(t->rest, t->capacity * sizeof(Poly *));
+        if (t->exps == NULL || t->rest == NULL)
+            exit(1);
+    }
+    poly_exp_t *e = &t->exps[t->size * t->count];
+    for (size_t v = 0; v < t->count; v++)
+        e[perm[v]] = path[v];
+    t->rest[t->size++] = rest;
+}
+
+/**
+ * Porównuje leksykograficznie wektory wykładników dwóch wyrazów.
+ * @param[in] t : wyrazy
+ * @param[in] a : numer wyrazu
+ * @param[in] b : numer wyrazu
+ * @return liczba dodatnia, jeśli wyraz @p a ma być przed @p b, ujemna wpp.
+ */
+static int PermTermsCompare(const PermTerms *t, size_t a, size_t b) {
+    const poly_exp_t *x = &t->exps[a * t->count];
+    const poly_exp_t *y = &t->exps[b * t->count];
+    for (size_t v = 0; v < t->count; v++) {
+        if (x[v] != y[v])
+            return x[v] > y[v] ? 1 : -1;
+    }
+    return 0;
+}
+
+/**
+ * Sortuje numery wyrazów malejąco według wektorów wykładników
+ * (sortowanie przez scalanie bez rekurencji).
+ * @param[in] t : wyrazy
+ * @param[in,out] order : numery wyrazów
+ */
+static void PermTermsSort(const PermTerms *t, size_t *order) {
+    size_t n = t->size;
+    size_t *tmp = malloc((n + 1) * sizeof(size_t));
+    if (tmp == NULL)
+        exit(1);
+    for (size_t width = 1; width < n; width *= 2) {
+        for (size_t lo = 0; lo < n; lo += 2 * width) {
+            size_t mid = lo + width < n ? lo + width : n;
+            size_t hi = lo + 2 * width < n ? lo + 2 * width : n;
+            size_t i = lo, j = mid, k = lo;
+            while (i < mid && j < hi)
+                tmp[k++] = PermTermsCompare(t, order[i], order[j]) >= 0 ? order[i++] : order[j++];
+            while (i < mid)
+                tmp[k++] = order[i++];
+            while (j < hi)
+                tmp[k++] = order[j++];
+        }
+        memcpy(order, tmp, n * sizeof(size_t));
+    }
+    free(tmp);
+}
+
+/**
+ * Struktura przechowująca budowany węzeł wielomianu.
+ */
+typedef struct PermNode {
+    Mono *monos;     ///< jednomiany węzła
+    size_t size;     ///< liczba jednomianów
+    size_t capacity; ///< pojemność tablicy jednomianów
+} PermNode;
+
+/**
+ * Dopisuje jednomian do budowanego węzła.
+ * @param[in] n : węzeł
+ * @param[in] m : jednomian
+ */
+static void PermNodePush(PermNode *n, Mono m) {
+    if (n->size == n->capacity) {
+        n->capacity = n->capacity == 0 ? 4 : 2 * n->capacity;
+        n->monos = realloc(n->monos, n->capacity * sizeof(Mono));
+        if (n->monos == NULL)
+            exit(1);
+    }
+    n->monos[n->size++] = m;
+}
+
+/**
+ * Kończy budowę węzła i opróżnia go.
+ * @param[in] n : węzeł z jednomianami w kolejności malejących wykładników
+ * @return wielomian
+ */
+static Poly PermNodeFinish(PermNode *n) {
+    Poly res = {.size = n->size, .arr = MonosAlloc(n->size + 1)};
+    memcpy(res.arr, n->monos, n->size * sizeof(Mono));
+    size_t k = n->size;
+    n->size = 0;
+    return PolyFinish(&res, k);
+}
+
+/**
+ * Kończy budowane węzły na poziomach od @p count - 1 do @p from
+ * i dopisuje je do węzłów o poziom wyżej.
+ * @param[in] nodes : budowane węzły kolejnych poziomów
+ * @param[in] count : liczba poziomów
+ * @param[in] from : najwyższy kończony poziom, większy od zera
+ * @param[in] prefix : wektor wykładników wyrazów w kończonych węzłach
+ */
+static void PermNodesClose(PermNode *nodes, size_t count, size_t from, const poly_exp_t *prefix) {
+    for (size_t v = count - 1; v >= from; v--) {
+        Poly child = PermNodeFinish(&nodes[v]);
+        PermNodePush(&nodes[v - 1], (Mono) {.p = child, .exp = prefix[v - 1]});
+    }
+}
+
+/**
+ * Zmienia kolejność pierwszych @p count zmiennych wielomianu.
+ * Wielomian jest rozpisywany na wyrazy do głębokości @p count, wektory
+ * wykładników są permutowane i sortowane, a wynik jest budowany w jednym
+ * przebiegu po posortowanych wyrazach: wyrazy o wspólnym prefiksie
+ * wykładników trafiają do wspólnego poddrzewa.
+ * @param[in] p : wielomian niebędący współczynnikiem
+ * @param[in] count : długość permutacji
+ * @param[in] perm : permutacja
+ * @return wielomian ze zmienionymi zmiennymi
+ */
+static Poly PolyPermuteNode(const Poly *p, size_t count, const size_t perm[]) {
+    PermTerms t = {.count = count};
+    poly_exp_t *path = calloc(count, sizeof(poly_exp_t));
+    if (path == NULL)
+        exit(1);
+
+    PolyWalk w;
+    PolyWalkInit(&w);
+    PolyWalkPush(&w, p, NULL, NULL);
+    while (!PolyWalkIsEmpty(&w)) {
+        PolyWalkFrame *f = PolyWalkTop(&w);
+        size_t level = w.size - 1;
+        if (f->i < f->p->size) {
+            const Mono *m = &f->p->arr[f->i++];
+            path[level] = m->exp;
+            if (PolyIsCoeff(&m->p) || level + 1 == count) {
+                for (size_t v = level + 1; v < count; v++)
+                    path[v] = 0;
+                PermTermsPush(&t, path, perm, &m->p);
+            }
+            else {
+                PolyWalkPush(&w, &m->p, NULL, NULL);
+            }
+        }
+        else {
+            PolyWalkPop(&w);
+        }
+    }
+    PolyWalkFree(&w);
+    free(path);
+
+    size_t *order = malloc((t.size + 1) * sizeof(size_t));
+    PermNode *nodes = calloc(count, sizeof(PermNode));
+    if (order == NULL || nodes == NULL)
+        exit(1);
+    for (size_t i = 0; i < t.size; i++)
+        order[i] = i;
+    PermTermsSort(&t, order);
+
+    // węzeł na poziomie l zbiera jednomiany zmiennej x_l wyrazów o tym samym
+    // prefiksie wykładników co bieżący wyraz; gdy prefiks się zmienia,
+    // głębsze węzły są kończone i dopisywane do swoich rodziców
+    const poly_exp_t *prev = NULL;
+    for (size_t n = 0; n < t.size; n++) {
+        const poly_exp_t *cur = &t.exps[order[n] * count];
+        if (prev != NULL) {
+            size_t l = 0;
+            while (prev[l] == cur[l])
+                l++;
+            PermNodesClose(nodes, count, l + 1, prev);
+        }
+        PermNodePush(&nodes[count - 1], (Mono) {.p = PolyClone(t.rest[order[n]]), .exp = cur[count - 1]});
+        prev = cur;
+    }
+    PermNodesClose(nodes, count, 1, prev);
+    Poly res = PermNodeFinish(&nodes[0]);
+
+    for (size_t v = 0; v < count; v++)
+        free(nodes[v].monos);
+    free(nodes);
+    free(order);
+    free(t.exps);
+    free(t.rest);
+    return res;
+}
+
+/**
+ * Zmienia kolejność zmiennych @f$x_{lo}, \ldots, x_{lo + count - 1}@f$
+ * wielomianu. Węzły powyżej poziomu @p lo są kopiowane.
+ * @param[in] p : wielomian
+ * @param[in] lo : numer pierwszej permutowanej zmiennej
+ * @param[in] count : liczba permutowanych zmiennych
+ * @param[in] perm : permutacja liczb @f$0, \ldots, count - 1@f$
+ * @return wielomian ze zmienionymi zmiennymi
+ */
+static Poly PolyPermuteFrom(const Poly *p, size_t lo, size_t count, const size_t perm[]) {
+    if (PolyIsCoeff(p) || count <= 1)
+        return PolyClone(p);
+    if (lo == 0)
+        return PolyPermuteNode(p, count, perm);
+
+    Poly q = PolyCloneNode(p);
+    PolyWalk w;
+    PolyWalkInit(&w);
+    PolyWalkPush(&w, p, NULL, &q);
+    while (!PolyWalkIsEmpty(&w)) {
+        PolyWalkFrame *f = PolyWalkTop(&w);
+        if (f->i < f->p->size) {
+            const Mono *m = &f->p->arr[f->i];
+            Mono *r = &f->res->arr[f->i];
+            f->i++;
+            r->exp = m->exp;
+            if (PolyIsCoeff(&m->p)) {
+                r->p = m->p;
+            }
+            else if (MonosBudgetStop()) {
+                // po przekroczeniu budżetu wynik i tak zostanie odrzucony
+                r->p = PolyZero();
+            }
+            else if (w.size == lo) {
+                r->p = PolyPermuteNode(&m->p, count, perm);
+            }
+            else {
+                r->p = PolyCloneNode(&m->p);
+                PolyWalkPush(&w, &m->p, NULL, &r->p);
+            }
+        }
+        else {
+            PolyUpdateInfo(f->res);
+            PolyWalkPop(&w);
+        }
+    }
+    PolyWalkFree(&w);
     return q;
 }
 
+Poly PolyPermute(const Poly *p, size_t count, const size_t perm[]) {
+    // zmienne, które pozostają na miejscu na początku i na końcu permutacji,
+    // nie są rozpisywane
+    size_t lo = 0;
+    while (lo < count && perm[lo] == lo)
+        lo++;
+    while (count > lo && perm[count - 1] == count - 1)
+        count--;
+    if (lo == count)
+        return PolyClone(p);
+
+    size_t *window = malloc((count - lo) * sizeof(size_t));
+    if (window == NULL)
+        exit(1);
+    for (size_t v = lo; v < count; v++)
+        window[v - lo] = perm[v] - lo;
+    Poly res = PolyPermuteFrom(p, lo, count - lo, window);
+    free(window);
+    return res;
+}
+
+/**
+ * Daje liczbę poziomów zagnieżdżenia wielomianu, czyli liczbę zmiennych
+ * @f$x_0, x_1, \ldots@f$, od których wielomian może zależeć.
+ * @param[in] p : wielomian
+ * @return liczba poziomów
+ */
+static size_t PolyDepth(const Poly *p) {
+    if (PolyIsCoeff(p))
+        return 0;
+    size_t depth = 0;
+    PolyWalk w;
+    PolyWalkInit(&w);
+    PolyWalkPush(&w, p, NULL, NULL);
+    while (!PolyWalkIsEmpty(&w)) {
+        PolyWalkFrame *f = PolyWalkTop(&w);
+        if (w.size > depth)
+            depth = w.size;
+        if (f->i < f->p->size) {
+            const Poly *c = &f->p->arr[f->i++].p;
+            if (!PolyIsCoeff(c))
+                PolyWalkPush(&w, c, NULL, NULL);
+        }
+        else {
+            PolyWalkPop(&w);
+        }
+    }
+    PolyWalkFree(&w);
+    return depth;
+}
+
+/**
+ * Obudowuje wielomian węzłami o jednym jednomianie z wykładnikiem 0,
+ * przesuwając jego zmienne o @p levels dalej.
+ * @param[in] p : wielomian niebędący współczynnikiem (przejmowany)
+ * @param[in] levels : liczba węzłów
+ * @return obudowany wielomian
+ */
+static Poly PolyWrap(Poly p, size_t levels) {
+    // po przekroczeniu budżetu wynik i tak zostanie odrzucony
+    for (size_t k = 0; k < levels && !MonosBudgetStop(); k++) {
+        Poly n = {.size = 1, .arr = MonosAlloc(2)};
+        n.arr[0] = (Mono) {.p = p, .exp = 0};
+        PolyUpdateInfo(&n);
+        p = n;
+    }
+    return p;
+}
+
+/**
+ * Zamienia zmienną @f$x_{level}@f$ na @f$x_{level + shift}@f$ wielomianu,
+ * który nie zależy od zmiennych o numerach większych niż @p level.
+ * Węzły powyżej poziomu @p level są kopiowane, a kopie węzłów poziomu
+ * @p level są obudowywane @p shift węzłami (PolyWrap).
+ * @param[in] p : wielomian
+ * @param[in] level : numer przesuwanej zmiennej
+ * @param[in] shift : przesunięcie
+ * @return wielomian ze zmienioną zmienną
+ */
+static Poly PolyShiftFrom(const Poly *p, size_t level, size_t shift) {
+    if (PolyIsCoeff(p))
+        return PolyClone(p);
+    if (level == 0)
+        return PolyWrap(PolyClone(p), shift);
+
+    Poly q = PolyCloneNode(p);
+    PolyWalk w;
+    PolyWalkInit(&w);
+    PolyWalkPush(&w, p, NULL, &q);
+    while (!PolyWalkIsEmpty(&w)) {
+        PolyWalkFrame *f = PolyWalkTop(&w);
+        if (f->i < f->p->size) {
+            const Mono *m = &f->p->arr[f->i];
+            Mono *r = &f->res->arr[f->i];
+            f->i++;
+            r->exp = m->exp;
+            if (PolyIsCoeff(&m->p)) {
+                r->p = m->p;
+            }
+            else if (MonosBudgetStop()) {
+                r->p = PolyZero();
+            }
+            else if (w.size == level) {
+                r->p = PolyWrap(PolyClone(&m->p), shift);
+            }
+            else {
+                r->p = PolyCloneNode(&m->p);
+                PolyWalkPush(&w, &m->p, NULL, &r->p);
+            }
+        }
+        else {
+            PolyUpdateInfo(f->res);
+            PolyWalkPop(&w);
+        }
+    }
+    PolyWalkFree(&w);
+    return q;
+}
+
+Poly PolySwapVars(const Poly *p, size_t i, size_t j) {
+    size_t lo = i < j ? i : j;
+    size_t hi = i < j ? j : i;
+    size_t depth = PolyDepth(p);
+    // wielomian nie zależy od żadnej z zamienianych zmiennych
+    if (i == j || lo >= depth)
+        return PolyClone(p);
+    // jeśli wielomian nie zależy od x_hi, to x_lo jest zamieniane z x_depth,
+    // a x_depth jest potem przesuwane na x_hi, więc permutowane są tylko
+    // zmienne, od których wielomian zależy
+    size_t top = hi < depth ? hi : depth;
+    size_t count = top - lo + 1;
+    size_t *window = malloc(count * sizeof(size_t));
+    if (window == NULL)
+        exit(1);
+    for (size_t v = 0; v < count; v++)
+        window[v] = v;
+    window[0] = count - 1;
+    window[count - 1] = 0;
+    Poly res = PolyPermuteFrom(p, lo, count, window);
+    free(window);
+    if (hi > depth) {
+        Poly shifted = PolyShiftFrom(&res, depth, hi - depth);
+        PolyDestroy(&res);
+        res = shifted;
+    }
+    return res;
+}
+
 void PolyToString(Poly *p, int ind) {
     if (PolyIsZero(p))
         printf("0");
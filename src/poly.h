@@ -12,6 +12,7 @@
 #include <assert.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 /** To jest typ reprezentujący współczynniki. */
 typedef long poly_coeff_t;
@@ -141,6 +142,29 @@ static inline Mono MonoClone(const Mono *m) {
     return (Mono) {.p = PolyClone(&m->p), .exp = m->exp};
 }
 
+/**
+ * Zamraża wielomian: przenosi wszystkie jego węzły do jednego ciągłego
+ * bloku pamięci, w kolejności pre-order. Zamrożony wielomian może być
+ * czytany przez wszystkie operacje jak zwykły wielomian, a funkcje
+ * przejmujące go na własność i zmieniające go najpierw go rozmrażają.
+ * @param[in,out] p : wielomian
+ */
+void PolyFreeze(Poly *p);
+
+/**
+ * Rozmraża wielomian: przenosi jego węzły do osobnych tablic jednomianów.
+ * Nic nie robi, jeśli wielomian nie jest zamrożony.
+ * @param[in,out] p : wielomian
+ */
+void PolyThaw(Poly *p);
+
+/**
+ * Sprawdza, czy wielomian jest zamrożony.
+ * @param[in] p : wielomian
+ * @return Czy wielomian jest zamrożony?
+ */
+bool PolyIsFrozen(const Poly *p);
+
 /**
  * Dodaje dwa wielomiany.
  * @param[in] p : wielomian @f$p@f$
@@ -149,6 +173,16 @@ static inline Mono MonoClone(const Mono *m) {
  */
 Poly PolyAdd(const Poly *p, const Poly *q);
 
+/**
+ * Dodaje dwa wielomiany.
+ * Przejmuje na własność zawartość struktur wskazywanych przez @p p i @p q:
+ * jednomiany argumentów są przenoszone do wyniku, a nie kopiowane.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @return @f$p + q@f$
+ */
+Poly PolyAddOwned(Poly *p, Poly *q);
+
 /**
  * Sumuje listę jednomianów i tworzy z nich wielomian.
  * Przejmuje na własność zawartość tablicy @p monos.
@@ -166,6 +200,41 @@ Poly PolyAddMonos(size_t count, const Mono monos[]);
  */
 Poly PolyMul(const Poly *p, const Poly *q);
 
+/**
+ * Dodaje iloczyn dwóch wielomianów do wielomianu @p acc.
+ * Jednomiany iloczynu są dodawane wprost do @p acc, bez budowania
+ * samego iloczynu. Przejmuje na własność zawartość struktury
+ * wskazywanej przez @p acc i zapisuje w niej wynik.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @param[in,out] acc : wielomian @f$r@f$, zastępowany przez @f$r + p * q@f$
+ */
+void PolyMulAdd(const Poly *p, const Poly *q, Poly *acc);
+
+/**
+ * Mnoży dwa wielomiany, pomijając jednomiany iloczynu stopnia większego
+ * od @p deg. Pomijane jednomiany nie są w ogóle wyliczane.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @param[in] deg : największy stopień jednomianów wyniku
+ * @return @f$p * q@f$ obcięty do stopnia @p deg
+ */
+Poly PolyMulTrunc(const Poly *p, const Poly *q, poly_exp_t deg);
+
+/**
+ * Mnoży dwa wielomiany, pomijając jednomiany iloczynu stopnia większego
+ * od @p deg oraz jednomiany, w których zmienna @f$x_i@f$ dla
+ * @f$i < @f$ @p count występuje w potędze większej od @p var_deg[i].
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @param[in] deg : największy stopień jednomianów wyniku
+ * @param[in] count : liczba ograniczanych zmiennych
+ * @param[in] var_deg : największe stopnie wyniku ze względu na kolejne zmienne
+ * @return obcięty iloczyn @f$p * q@f$
+ */
+Poly PolyMulTruncVars(const Poly *p, const Poly *q, poly_exp_t deg,
+                      size_t count, const poly_exp_t var_deg[]);
+
 /**
  * Zwraca przeciwny wielomian.
  * @param[in] p : wielomian @f$p@f$
@@ -181,6 +250,26 @@ Poly PolyNeg(const Poly *p);
  */
 Poly PolySub(const Poly *p, const Poly *q);
 
+/**
+ * Sumuje tablicę wielomianów.
+ * Wszystkie wielomiany są scalane jednocześnie (scalanie k-wielomianów),
+ * więc każdy jednomian jest kopiowany tylko raz.
+ * @param[in] count : liczba wielomianów
+ * @param[in] polys : tablica wielomianów
+ * @return suma wielomianów (0 dla pustej tablicy)
+ */
+Poly PolyAddMany(size_t count, const Poly polys[]);
+
+/**
+ * Mnoży tablicę wielomianów.
+ * Iloczyn jest liczony w zrównoważonym drzewie mnożeń, a niezależne
+ * poddrzewa są liczone współbieżnie.
+ * @param[in] count : liczba wielomianów
+ * @param[in] polys : tablica wielomianów
+ * @return iloczyn wielomianów (1 dla pustej tablicy)
+ */
+Poly PolyMulMany(size_t count, const Poly polys[]);
+
 /**
  * Zwraca stopień wielomianu ze względu na zadaną zmienną (-1 dla wielomianu
  * tożsamościowo równego zeru). Zmienne indeksowane są od 0.
@@ -208,6 +297,16 @@ poly_exp_t PolyDeg(const Poly *p);
  */
 bool PolyIsEq(const Poly *p, const Poly *q);
 
+/**
+ * Zwraca strukturalny skrót wielomianu.
+ * Równe wielomiany mają równe skróty. Skrót jest wyliczany przy pierwszym
+ * użyciu i zapamiętywany w wielomianie, więc kolejne wywołania działają
+ * w czasie stałym.
+ * @param[in] p : wielomian
+ * @return skrót wielomianu @p p
+ */
+uint64_t PolyHash(const Poly *p);
+
 /**
  * Wylicza wartość wielomianu w punkcie @p x.
  * Wstawia pod pierwszą zmienną wielomianu wartość @p x.
@@ -221,6 +320,29 @@ bool PolyIsEq(const Poly *p, const Poly *q);
  */
 Poly PolyAt(const Poly *p, poly_coeff_t x);
 
+/**
+ * Zmienia kolejność zmiennych wielomianu: zmienna @f$x_i@f$ dla
+ * @f$i < @f$ @p count staje się zmienną @f$x_{perm[i]}@f$, a pozostałe
+ * zmienne nie zmieniają się.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] count : długość permutacji
+ * @param[in] perm : permutacja liczb @f$0, \ldots, count - 1@f$
+ * @return wielomian ze zmienionymi zmiennymi
+ */
+Poly PolyPermute(const Poly *p, size_t count, const size_t perm[]);
+
+/**
+ * Zamienia miejscami dwie zmienne wielomianu. Jeśli wielomian zależy od
+ * zmiennej o mniejszym numerze, wynik ma tyle poziomów zagnieżdżenia, ile
+ * wynosi większy numer. Po przekroczeniu budżetu pamięci (MonosBudgetStop)
+ * budowa wyniku jest przerywana, a wynik nadaje się tylko do usunięcia.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] i : numer zmiennej
+ * @param[in] j : numer zmiennej
+ * @return wielomian @f$p@f$ z zamienionymi zmiennymi @f$x_i@f$ i @f$x_j@f$
+ */
+Poly PolySwapVars(const Poly *p, size_t i, size_t j);
+
 void PolyToString(Poly *p, int ind);
 
 void MonoToString(Mono *m, int ind);
@@ -0,0 +1,74 @@
+/** @file
+  Implementacja akumulatora sum wielomianów (geokubełków).
+*/
+
+#include "poly_accumulator.h"
+
+/**
+ * Daje liczbę jednomianów wielomianu (1 dla współczynnika).
+ * @param[in] p : wielomian
+ * @return liczba jednomianów
+ */
+static size_t accSize(const Poly *p) {
+    return PolyIsCoeff(p) ? 1 : p->size;
+}
+
+/**
+ * Daje numer kubełka, w którym mieści się wielomian o podanym rozmiarze.
+ * @param[in] size : liczba jednomianów
+ * @return numer kubełka
+ */
+static int accBucket(size_t size) {
+    int i = 0;
+    size_t capacity = 4;
+    while (size > capacity && i < POLY_ACC_BUCKETS - 1) {
+        capacity *= 4;
+        i++;
+    }
+    return i;
+}
+
+void PolyAccInit(PolyAccumulator *acc) {
+    for (int i = 0; i < POLY_ACC_BUCKETS; i++)
+        acc->buckets[i] = PolyZero();
+}
+
+void PolyAccAddPoly(PolyAccumulator *acc, Poly *p) {
+    if (PolyIsZero(p))
+        return;
+    Poly sum = *p;
+    int i = accBucket(accSize(&sum));
+    for (;;) {
+        sum = PolyAddOwned(&acc->buckets[i], &sum);
+        acc->buckets[i] = PolyZero();
+        int j = accBucket(accSize(&sum));
+        if (j <= i) {
+            acc->buckets[i] = sum;
+            return;
+        }
+        i = j;
+    }
+}
+
+void PolyAccAddMono(PolyAccumulator *acc, Mono *m) {
+    if (PolyIsZero(&m->p))
+        return;
+    Poly p = PolyAddMonos(1, m);
+    PolyAccAddPoly(acc, &p);
+}
+
+Poly PolyAccFinish(PolyAccumulator *acc) {
+    Poly sum = PolyZero();
+    for (int i = 0; i < POLY_ACC_BUCKETS; i++) {
+        sum = PolyAddOwned(&acc->buckets[i], &sum);
+        acc->buckets[i] = PolyZero();
+    }
+    return sum;
+}
+
+void PolyAccDestroy(PolyAccumulator *acc) {
+    for (int i = 0; i < POLY_ACC_BUCKETS; i++) {
+        PolyDestroy(&acc->buckets[i]);
+        acc->buckets[i] = PolyZero();
+    }
+}
@@ -0,0 +1,73 @@
+/** @file
+  Interfejs akumulatora sum wielomianów (geokubełków).
+
+  Akumulator przechowuje sumę częściową w kubełkach o geometrycznie
+  rosnących pojemnościach: kubełek o numerze @f$i@f$ mieści wielomian
+  o co najwyżej @f$4^{i+1}@f$ jednomianach. Dodawany wielomian trafia do
+  kubełka odpowiedniego dla swojego rozmiaru, a kubełek, który się
+  przepełnił, jest przenoszony do następnego. Dzięki temu każdy jednomian
+  bierze udział w logarytmicznej liczbie scaleń, a długi ciąg dodawań
+  działa w czasie bliskim liniowemu.
+*/
+
+#ifndef _POLY_ACCUMULATOR_H
+#define _POLY_ACCUMULATOR_H
+
+#include "poly.h"
+
+/** Liczba kubełków akumulatora. */
+#define POLY_ACC_BUCKETS 16
+
+/**
+ * Struktura przechowująca akumulator.
+ */
+typedef struct PolyAccumulator {
+    Poly buckets[POLY_ACC_BUCKETS]; ///< kubełki z sumami częściowymi
+} PolyAccumulator;
+
+/**
+ * Inicjuje pusty akumulator (o sumie równej zeru).
+ * @param[in] acc : akumulator
+ */
+void PolyAccInit(PolyAccumulator *acc);
+
+/**
+ * Dodaje wielomian do akumulatora.
+ * Przejmuje na własność zawartość struktury wskazywanej przez @p p.
+ * @param[in] acc : akumulator
+ * @param[in] p : wielomian
+ */
+void PolyAccAddPoly(PolyAccumulator *acc, Poly *p);
+
+/**
+ * Dodaje jednomian do akumulatora.
+ * Przejmuje na własność zawartość struktury wskazywanej przez @p m.
+ * @param[in] acc : akumulator
+ * @param[in] m : jednomian
+ */
+void PolyAccAddMono(PolyAccumulator *acc, Mono *m);
+
+/**
+ * Dodaje do akumulatora iloczyn dwóch wielomianów, bez budowania
+ * samego iloczynu: iloczyny kolejnych jednomianów @p p przez @p q
+ * są od razu dodawane do akumulatora.
+ * @param[in] acc : akumulator
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ */
+void PolyAccAddMul(PolyAccumulator *acc, const Poly *p, const Poly *q);
+
+/**
+ * Daje sumę wielomianów dodanych do akumulatora i opróżnia go.
+ * @param[in] acc : akumulator
+ * @return suma wielomianów
+ */
+Poly PolyAccFinish(PolyAccumulator *acc);
+
+/**
+ * Usuwa zawartość akumulatora z pamięci.
+ * @param[in] acc : akumulator
+ */
+void PolyAccDestroy(PolyAccumulator *acc);
+
+#endif //_POLY_ACCUMULATOR_H
@@ -0,0 +1,201 @@
+/** @file
+  Implementacja pamięci podręcznej wyników operacji na wielomianach.
+*/
+
+#include <stdlib.h>
+#include <stdint.h>
+#include "poly_cache.h"
+#include "monos.h"
+
+/** Początkowa liczba kubełków tablicy haszującej. */
+#define CACHE_INIT_BUCKETS 64
+
+/**
+ * Struktura przechowująca wpis pamięci podręcznej.
+ */
+typedef struct CacheEntry {
+    uint64_t key;              ///< skrót operacji i argumentów
+    int op;                    ///< kod operacji
+    poly_coeff_t x;            ///< argument operacji CACHE_AT
+    Poly p;                    ///< kopia pierwszego argumentu
+    Poly q;                    ///< kopia drugiego argumentu
+    Poly res;                  ///< kopia wyniku
+    size_t bytes;              ///< pamięć zajmowana przez wpis
+    struct CacheEntry *chain;  ///< następny wpis w kubełku
+    struct CacheEntry *prev;   ///< wpis używany ostatnio później
+    struct CacheEntry *next;   ///< wpis używany ostatnio wcześniej
+} CacheEntry;
+
+/**
+ * Odłącza wpis od listy LRU.
+ * @param[in] cache : pamięć podręczna
+ * @param[in] e : wpis
+ */
+static void lruUnlink(PolyCache *cache, CacheEntry *e) {
+    if (e->prev != NULL)
+        e->prev->next = e->next;
+    else
+        cache->newest = e->next;
+    if (e->next != NULL)
+        e->next->prev = e->prev;
+    else
+        cache->oldest = e->prev;
+}
+
+/**
+ * Wstawia wpis na początek listy LRU.
+ * @param[in] cache : pamięć podręczna
+ * @param[in] e : wpis
+ */
+static void lruPushFront(PolyCache *cache, CacheEntry *e) {
+    e->prev = NULL;
+    e->next = cache->newest;
+    if (cache->newest != NULL)
+        cache->newest->prev = e;
+    cache->newest = e;
+    if (cache->oldest == NULL)
+        cache->oldest = e;
+}
+
+/**
+ * Usuwa wpis z pamięci podręcznej i zwalnia go.
+ * @param[in] cache : pamięć podręczna
+ * @param[in] e : wpis
+ */
+static void entryRemove(PolyCache *cache, CacheEntry *e) {
+    CacheEntry **link = &cache->buckets[e->key & (cache->bucket_count - 1)];
+    while (*link != e)
+        link = &(*link)->chain;
+    *link = e->chain;
+    lruUnlink(cache, e);
+    cache->stats.entries--;
+    cache->stats.bytes -= e->bytes;
+    PolyDestroy(&e->p);
+    PolyDestroy(&e->q);
+    PolyDestroy(&e->res);
+    free(e);
+}
+
+/**
+ * Podwaja liczbę kubełków tablicy haszującej.
+ * @param[in] cache : pamięć podręczna
+ */
+static void bucketsGrow(PolyCache *cache) {
+    size_t count = 2 * cache->bucket_count;
+    CacheEntry **buckets = calloc(count, sizeof(CacheEntry *));
+    if (buckets == NULL)
+        exit(1);
+    for (size_t i = 0; i < cache->bucket_count; i++) {
+        CacheEntry *e = cache->buckets[i];
+        while (e != NULL) {
+            CacheEntry *next = e->chain;
+            e->chain = buckets[e->key & (count - 1)];
+            buckets[e->key & (count - 1)] = e;
+            e = next;
+        }
+    }
+    free(cache->buckets);
+    cache->buckets = buckets;
+    cache->bucket_count = count;
+}
+
+void PolyCacheInit(PolyCache *cache, size_t max_bytes) {
+    PolyCacheDestroy(cache);
+    if (max_bytes == 0)
+        return;
+    cache->buckets = calloc(CACHE_INIT_BUCKETS, sizeof(CacheEntry *));
+    if (cache->buckets == NULL)
+        exit(1);
+    cache->bucket_count = CACHE_INIT_BUCKETS;
+    cache->max_bytes = max_bytes;
+}
+
+bool PolyCacheEnabled(const PolyCache *cache) {
+    return cache->buckets != NULL;
+}
+
+/**
+ * Wykonuje operację bez użycia pamięci podręcznej.
+ * @param[in] op : kod operacji
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @param[in] x : wartość argumentu @f$x@f$
+ * @return wynik operacji
+ */
+static Poly compute(int op, const Poly *p, const Poly *q, poly_coeff_t x) {
+    if (op == CACHE_ADD)
+        return PolyAdd(p, q);
+    if (op == CACHE_MUL)
+        return PolyMul(p, q);
+    return PolyAt(p, x);
+}
+
+Poly PolyCacheApply(PolyCache *cache, int op, const Poly *p, const Poly *q, poly_coeff_t x) {
+    if (!PolyCacheEnabled(cache))
+        return compute(op, p, q, x);
+
+    Poly zero = PolyZero();
+    if (op == CACHE_AT)
+        q = &zero;
+    uint64_t hp = PolyHash(p);
+    uint64_t hq = PolyHash(q);
+    if (op != CACHE_AT && hq < hp) { // dodawanie i mnożenie są przemienne
+        const Poly *t = p;
+        p = q;
+        q = t;
+        uint64_t ht = hp;
+        hp = hq;
+        hq = ht;
+    }
+    uint64_t key = hp * 0x9e3779b97f4a7c15ULL ^ hq ^ ((uint64_t)x << 2) ^ (uint64_t)op;
+    key ^= key >> 32;
+
+    for (CacheEntry *e = cache->buckets[key & (cache->bucket_count - 1)]; e != NULL; e = e->chain) {
+        if (e->key == key && e->op == op && e->x == x
+            && PolyIsEq(&e->p, p) && PolyIsEq(&e->q, q)) {
+            cache->stats.hits++;
+            lruUnlink(cache, e);
+            lruPushFront(cache, e);
+            return PolyClone(&e->res);
+        }
+    }
+
+    cache->stats.misses++;
+    unsigned long mark = MonosBudgetMark();
+    Poly res = compute(op, p, q, x);
+    if (MonosOverBudgetSince(mark)) // wynik mógł zostać obliczony tylko częściowo
+        return res;
+    size_t bytes = sizeof(CacheEntry) + MonosBytesOfPoly(p) + MonosBytesOfPoly(q) + MonosBytesOfPoly(&res);
+    if (bytes > cache->max_bytes)
+        return res;
+    while (cache->stats.bytes + bytes > cache->max_bytes)
+        entryRemove(cache, cache->oldest);
+
+    CacheEntry *e = malloc(sizeof(CacheEntry));
+    if (e == NULL)
+        exit(1);
+    *e = (CacheEntry) {.key = key, .op = op, .x = x, .p = PolyClone(p),
+                       .q = PolyClone(q), .res = PolyClone(&res), .bytes = bytes};
+    if (cache->stats.entries >= cache->bucket_count)
+        bucketsGrow(cache);
+    e->chain = cache->buckets[key & (cache->bucket_count - 1)];
+    cache->buckets[key & (cache->bucket_count - 1)] = e;
+    lruPushFront(cache, e);
+    cache->stats.entries++;
+    cache->stats.bytes += bytes;
+    return res;
+}
+
+PolyCacheStats PolyCacheGetStats(const PolyCache *cache) {
+    return cache->stats;
+}
+
+void PolyCacheDestroy(PolyCache *cache) {
+    while (cache->oldest != NULL)
+        entryRemove(cache, cache->oldest);
+    free(cache->buckets);
+    cache->buckets = NULL;
+    cache->bucket_count = 0;
+    cache->max_bytes = 0;
+    cache->stats = (PolyCacheStats) {0};
+}
@@ -0,0 +1,89 @@
+/** @file
+  Interfejs pamięci podręcznej wyników operacji na wielomianach.
+
+  Pamięć podręczna jest opcjonalna (domyślnie wyłączona) i ograniczona
+  rozmiarem w bajtach. Po przekroczeniu limitu usuwane są najdawniej
+  używane wpisy (LRU). Wpisy są rozpoznawane po strukturalnym skrócie
+  argumentów i kodzie operacji, a trafienie jest potwierdzane pełnym
+  porównaniem argumentów.
+
+  Każdy kalkulator ma własną pamięć podręczną. Pamięć podręczna nie jest
+  chroniona blokadą, więc może jej używać naraz tylko jeden wątek.
+*/
+
+#ifndef _POLY_CACHE_H
+#define _POLY_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "poly.h"
+
+#define CACHE_ADD 0
+#define CACHE_MUL 1
+#define CACHE_AT 2
+
+/**
+ * Struktura przechowująca statystyki pamięci podręcznej.
+ */
+typedef struct PolyCacheStats {
+    unsigned long hits;   ///< liczba trafień
+    unsigned long misses; ///< liczba chybień
+    size_t entries;       ///< liczba wpisów
+    size_t bytes;         ///< szacowana pamięć zajmowana przez wpisy
+} PolyCacheStats;
+
+/**
+ * Struktura przechowująca pamięć podręczną. Wyzerowana struktura jest
+ * wyłączoną pamięcią podręczną.
+ */
+typedef struct PolyCache {
+    struct CacheEntry **buckets; ///< kubełki tablicy haszującej
+    size_t bucket_count;         ///< liczba kubełków
+    struct CacheEntry *newest;   ///< ostatnio używany wpis
+    struct CacheEntry *oldest;   ///< najdawniej używany wpis
+    size_t max_bytes;            ///< limit pamięci
+    PolyCacheStats stats;        ///< statystyki
+} PolyCache;
+
+/**
+ * Włącza pamięć podręczną o podanym limicie pamięci.
+ * Limit równy 0 wyłącza pamięć podręczną i usuwa wszystkie wpisy.
+ * @param[in] cache : pamięć podręczna
+ * @param[in] max_bytes : limit pamięci w bajtach
+ */
+void PolyCacheInit(PolyCache *cache, size_t max_bytes);
+
+/**
+ * Sprawdza, czy pamięć podręczna jest włączona.
+ * @param[in] cache : pamięć podręczna
+ * @return Czy pamięć podręczna jest włączona?
+ */
+bool PolyCacheEnabled(const PolyCache *cache);
+
+/**
+ * Wykonuje operację, korzystając z pamięci podręcznej.
+ * Dla operacji CACHE_ADD i CACHE_MUL liczy @f$p + q@f$ oraz @f$p * q@f$,
+ * dla CACHE_AT liczy @f$p(x)@f$ (wtedy @p q jest ignorowane).
+ * @param[in] cache : pamięć podręczna
+ * @param[in] op : kod operacji
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @param[in] x : wartość argumentu @f$x@f$
+ * @return wynik operacji
+ */
+Poly PolyCacheApply(PolyCache *cache, int op, const Poly *p, const Poly *q, poly_coeff_t x);
+
+/**
+ * Daje statystyki pamięci podręcznej.
+ * @param[in] cache : pamięć podręczna
+ * @return statystyki
+ */
+PolyCacheStats PolyCacheGetStats(const PolyCache *cache);
+
+/**
+ * Usuwa wszystkie wpisy i wyłącza pamięć podręczną.
+ * @param[in] cache : pamięć podręczna
+ */
+void PolyCacheDestroy(PolyCache *cache);
+
+#endif //_POLY_CACHE_H
@@ -0,0 +1,41 @@
+/** @file
+  Implementacja operacji na gęstych wektorach współczynników.
+*/
+
+#include "poly_dense.h"
+
+void DenseAdd(uint64_t *restrict dst, const uint64_t *restrict src, size_t n) {
+    for (size_t i = 0; i < n; i++)
+        dst[i] += src[i];
+}
+
+void DenseNeg(uint64_t *dst, size_t n) {
+    for (size_t i = 0; i < n; i++)
+        dst[i] = -dst[i];
+}
+
+void DenseScale(uint64_t *dst, size_t n, uint64_t c) {
+    for (size_t i = 0; i < n; i++)
+        dst[i] *= c;
+}
+
+void DenseConvolve(uint64_t *restrict dst, const uint64_t *restrict a, size_t na,
+                   const uint64_t *restrict b, size_t nb) {
+    // krótszy wektor w pętli zewnętrznej, dłuższy w wektoryzowanej wewnętrznej
+    if (na > nb) {
+        const uint64_t *t = a;
+        a = b;
+        b = t;
+        size_t tn = na;
+        na = nb;
+        nb = tn;
+    }
+    for (size_t i = 0; i < na; i++) {
+        uint64_t c = a[i];
+        if (c == 0)
+            continue;
+        uint64_t *restrict row = dst + i;
+        for (size_t j = 0; j < nb; j++)
+            row[j] += c * b[j];
+    }
+}
@@ -0,0 +1,57 @@
+/** @file
+  Interfejs operacji na gęstych wektorach współczynników.
+
+  Węzeł wielomianu, którego wszystkie jednomiany mają stałe współczynniki
+  (liść), a wykładniki zajmują większość przedziału od 0 do stopnia,
+  może być na czas operacji zapisany jako gęsty wektor współczynników
+  indeksowany wykładnikami. Operacje na takich wektorach to proste pętle
+  bez rozgałęzień, które kompilator zamienia na instrukcje wektorowe.
+  Obliczenia są wykonywane na liczbach bez znaku, więc przepełnienie ma
+  ten sam skutek (arytmetyka modulo @f$2^{64}@f$) co w postaci rzadkiej.
+*/
+
+#ifndef _POLY_DENSE_H
+#define _POLY_DENSE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** Najmniejsza liczba jednomianów liścia zapisywanego w postaci gęstej. */
+#define DENSE_MIN_SIZE 8
+
+/**
+ * Dodaje wektor @p src do wektora @p dst.
+ * @param[in,out] dst : wektor współczynników
+ * @param[in] src : wektor współczynników
+ * @param[in] n : długość wektorów
+ */
+void DenseAdd(uint64_t *dst, const uint64_t *src, size_t n);
+
+/**
+ * Zastępuje wektor wektorem przeciwnym.
+ * @param[in,out] dst : wektor współczynników
+ * @param[in] n : długość wektora
+ */
+void DenseNeg(uint64_t *dst, size_t n);
+
+/**
+ * Mnoży wektor przez liczbę.
+ * @param[in,out] dst : wektor współczynników
+ * @param[in] n : długość wektora
+ * @param[in] c : mnożnik
+ */
+void DenseScale(uint64_t *dst, size_t n, uint64_t c);
+
+/**
+ * Dodaje do wektora @p dst splot wektorów @p a i @p b, czyli iloczyn
+ * wielomianów o tych współczynnikach.
+ * @param[in,out] dst : wektor długości @p na + @p nb - 1
+ * @param[in] a : wektor współczynników
+ * @param[in] na : długość wektora @p a
+ * @param[in] b : wektor współczynników
+ * @param[in] nb : długość wektora @p b
+ */
+void DenseConvolve(uint64_t *dst, const uint64_t *a, size_t na,
+                   const uint64_t *b, size_t nb);
+
+#endif //_POLY_DENSE_H
@@ -0,0 +1,286 @@
+/** @file
+  Implementacja leniwych wyrażeń na wielomianach.
+*/
+
+#include <stdlib.h>
+#include "poly_expr.h"
+#include "poly_accumulator.h"
+#include "monos.h"
+
+/** Węzeł o znanej wartości. */
+#define EXPR_VALUE 0
+/** Węzeł sumy składników. */
+#define EXPR_SUM 1
+/** Węzeł iloczynu dwóch wyrażeń. */
+#define EXPR_MUL 2
+
+/**
+ * Największa głębokość nieobliczonego wyrażenia. Głębsze poddrzewa są
+ * obliczane już przy budowaniu, co ogranicza głębokość rekurencji.
+ */
+#define EXPR_MAX_DEPTH 64
+
+/**
+ * Struktura przechowująca składnik sumy.
+ */
+typedef struct ExprTerm {
+    PolyExpr *e; ///< wyrażenie
+    bool neg;    ///< czy składnik jest brany ze znakiem minus
+} ExprTerm;
+
+/**
+ * Struktura przechowująca węzeł wyrażenia.
+ */
+struct PolyExpr {
+    int kind;          ///< rodzaj węzła
+    size_t refs;       ///< liczba odwołań do węzła
+    unsigned depth;    ///< głębokość nieobliczonego poddrzewa
+    Poly value;        ///< wartość węzła EXPR_VALUE
+    ExprTerm *terms;   ///< składniki węzła EXPR_SUM
+    bool neg;          ///< czy wszystkie składniki sumy mają przeciwny znak
+    size_t count;      ///< liczba składników
+    size_t capacity;   ///< pojemność tablicy składników
+    PolyExpr *a;       ///< pierwszy czynnik węzła EXPR_MUL
+    PolyExpr *b;       ///< drugi czynnik węzła EXPR_MUL
+};
+
+/**
+ * Tworzy nowy węzeł podanego rodzaju.
+ * @param[in] kind : rodzaj węzła
+ * @return węzeł
+ */
+static PolyExpr *exprNew(int kind) {
+    PolyExpr *e = calloc(1, sizeof(PolyExpr));
+    if (e == NULL)
+        exit(1);
+    e->kind = kind;
+    e->refs = 1;
+    e->value = PolyZero();
+    return e;
+}
+
+static void exprForce(PolyExpr *e);
+
+/**
+ * Przygotowuje wyrażenie do podpięcia pod nowy węzeł. Zbyt głębokie
+ * wyrażenie jest od razu obliczane.
+ * @param[in] e : wyrażenie
+ * @return głębokość wyrażenia
+ */
+static unsigned exprAttach(PolyExpr *e) {
+    if (e->depth >= EXPR_MAX_DEPTH) {
+        // obliczona wartość zastępuje poddrzewo na stałe, więc nie może
+        // zostać przerwana po przekroczeniu budżetu
+        bool stop = MonosSetBudgetStop(false);
+        exprForce(e);
+        MonosSetBudgetStop(stop);
+    }
+    return e->depth;
+}
+
+/**
+ * Dopisuje składnik do węzła sumy.
+ * @param[in] s : węzeł sumy
+ * @param[in] e : wyrażenie (odwołanie przechodzi na węzeł)
+ * @param[in] neg : czy składnik jest brany w sumie ze znakiem minus
+ */
+static void exprPushTerm(PolyExpr *s, PolyExpr *e, bool neg) {
+    if (s->count == s->capacity) {
+        s->capacity = s->capacity == 0 ? 4 : 2 * s->capacity;
+        s->terms = realloc(s->terms, s->capacity * sizeof(ExprTerm));
+        if (s->terms == NULL)
+            exit(1);
+    }
+    s->terms[s->count++] = (ExprTerm) {.e = e, .neg = neg != s->neg};
+}
+
+/**
+ * Dodaje wyrażenie do węzła sumy. Nieobliczona suma, do której nie ma
+ * innych odwołań, jest spłaszczana: jej składniki trafiają wprost do @p s.
+ * @param[in] s : węzeł sumy
+ * @param[in] e : wyrażenie (odwołanie przechodzi na węzeł)
+ * @param[in] neg : czy wyrażenie jest brane ze znakiem minus
+ */
+static void exprAppend(PolyExpr *s, PolyExpr *e, bool neg) {
+    if (e->kind == EXPR_SUM && e->refs == 1) {
+        for (size_t i = 0; i < e->count; i++)
+            exprPushTerm(s, e->terms[i].e, (e->terms[i].neg != e->neg) != neg);
+        if (e->depth > s->depth)
+            s->depth = e->depth;
+        free(e->terms);
+        free(e);
+        return;
+    }
+    unsigned depth = exprAttach(e) + 1;
+    if (depth > s->depth)
+        s->depth = depth;
+    exprPushTerm(s, e, neg);
+}
+
+PolyExpr *PolyExprLeaf(Poly *p) {
+    PolyExpr *e = exprNew(EXPR_VALUE);
+    e->value = *p;
+    return e;
+}
+
+/**
+ * Tworzy sumę dwóch wyrażeń. Nieobliczona suma, do której nie ma innych
+ * odwołań, jest rozszerzana w miejscu (z dwóch takich sum - większa), więc
+ * łańcuch dodawań kosztuje czas liniowy względem liczby składników.
+ * @param[in] a : wyrażenie (odwołanie przechodzi na wynik)
+ * @param[in] b : wyrażenie (odwołanie przechodzi na wynik)
+ * @param[in] neg : czy @p b jest brane ze znakiem minus
+ * @return wyrażenie @f$a \pm b@f$
+ */
+static PolyExpr *exprSum(PolyExpr *a, PolyExpr *b, bool neg) {
+    bool a_open = a->kind == EXPR_SUM && a->refs == 1;
+    bool b_open = b->kind == EXPR_SUM && b->refs == 1;
+    if (a_open && (!b_open || a->count >= b->count)) {
+        exprAppend(a, b, neg);
+        return a;
+    }
+    if (b_open) {
+        b->neg = b->neg != neg;
+        exprAppend(b, a, false);
+        return b;
+    }
+    PolyExpr *s = exprNew(EXPR_SUM);
+    exprAppend(s, a, false);
+    exprAppend(s, b, neg);
+    return s;
+}
+
+PolyExpr *PolyExprAdd(PolyExpr *a, PolyExpr *b) {
+    return exprSum(a, b, false);
+}
+
+PolyExpr *PolyExprSub(PolyExpr *a, PolyExpr *b) {
+    return exprSum(a, b, true);
+}
+
+PolyExpr *PolyExprNeg(PolyExpr *a) {
+    if (a->kind == EXPR_SUM && a->refs == 1) {
+        a->neg = !a->neg;
+        return a;
+    }
+    PolyExpr *s = exprNew(EXPR_SUM);
+    exprAppend(s, a, true);
+    return s;
+}
+
+PolyExpr *PolyExprMul(PolyExpr *a, PolyExpr *b) {
+    PolyExpr *m = exprNew(EXPR_MUL);
+    unsigned da = exprAttach(a);
+    unsigned db = exprAttach(b);
+    m->depth = (da > db ? da : db) + 1;
+    m->a = a;
+    m->b = b;
+    return m;
+}
+
+PolyExpr *PolyExprRetain(PolyExpr *e) {
+    e->refs++;
+    return e;
+}
+
+void PolyExprRelease(PolyExpr *e) {
+    if (--e->refs > 0)
+        return;
+    if (e->kind == EXPR_SUM) {
+        for (size_t i = 0; i < e->count; i++)
+            PolyExprRelease(e->terms[i].e);
+        free(e->terms);
+    }
+    else if (e->kind == EXPR_MUL) {
+        PolyExprRelease(e->a);
+        PolyExprRelease(e->b);
+    }
+    PolyDestroy(&e->value);
+    free(e);
+}
+
+/**
+ * Daje wartość obliczonego wyrażenia, zabierając ją z węzła, jeśli nie
+ * ma do niego innych odwołań.
+ * @param[in] e : obliczone wyrażenie
+ * @return wartość wyrażenia
+ */
+static Poly exprTakeValue(PolyExpr *e) {
+    if (e->refs > 1)
+        return PolyClone(&e->value);
+    Poly p = e->value;
+    e->value = PolyZero();
+    return p;
+}
+
+/**
+ * Dodaje składnik sumy do akumulatora i zwalnia odwołanie do niego.
+ * Nieobliczony iloczyn, do którego nie ma innych odwołań, jest dodawany
+ * do akumulatora bez budowania samego iloczynu.
+ * @param[in] acc : akumulator
+ * @param[in] t : składnik
+ */
+static void exprAccumulate(PolyAccumulator *acc, ExprTerm *t) {
+    PolyExpr *e = t->e;
+    if (e->kind == EXPR_MUL && e->refs == 1) {
+        exprForce(e->a);
+        exprForce(e->b);
+        if (!t->neg) {
+            PolyAccAddMul(acc, &e->a->value, &e->b->value);
+        }
+        else {
+            Poly neg = PolyNeg(&e->a->value);
+            PolyAccAddMul(acc, &neg, &e->b->value);
+            PolyDestroy(&neg);
+        }
+    }
+    else {
+        exprForce(e);
+        Poly p = exprTakeValue(e);
+        if (t->neg) {
+            Poly neg = PolyNeg(&p);
+            PolyDestroy(&p);
+            p = neg;
+        }
+        PolyAccAddPoly(acc, &p);
+    }
+    PolyExprRelease(e);
+}
+
+/**
+ * Oblicza wartość wyrażenia i zapamiętuje ją w węźle, zwalniając
+ * jego poddrzewo.
+ * @param[in] e : wyrażenie
+ */
+static void exprForce(PolyExpr *e) {
+    if (e->kind == EXPR_SUM) {
+        PolyAccumulator acc;
+        PolyAccInit(&acc);
+        for (size_t i = 0; i < e->count; i++) {
+            ExprTerm t = {.e = e->terms[i].e, .neg = e->terms[i].neg != e->neg};
+            exprAccumulate(&acc, &t);
+        }
+        free(e->terms);
+        e->terms = NULL;
+        e->count = e->capacity = 0;
+        e->neg = false;
+        e->value = PolyAccFinish(&acc);
+    }
+    else if (e->kind == EXPR_MUL) {
+        exprForce(e->a);
+        exprForce(e->b);
+        e->value = PolyMul(&e->a->value, &e->b->value);
+        PolyExprRelease(e->a);
+        PolyExprRelease(e->b);
+        e->a = e->b = NULL;
+    }
+    e->kind = EXPR_VALUE;
+    e->depth = 0;
+}
+
+Poly PolyExprEval(PolyExpr *e) {
+    exprForce(e);
+    Poly p = exprTakeValue(e);
+    PolyExprRelease(e);
+    return p;
+}
@@ -0,0 +1,85 @@
+/** @file
+  Interfejs leniwych wyrażeń na wielomianach.
+
+  W trybie leniwym kalkulator nie wykonuje od razu dodawań, odejmowań,
+  negacji i mnożeń, tylko buduje z nich graf wyrażenia. Węzły grafu mają
+  licznik odwołań, więc skopiowane wyrażenie jest współdzielone, a jego
+  wartość liczona co najwyżej raz. Wyrażenie jest obliczane dopiero wtedy,
+  gdy potrzebna jest jego wartość. Sumy kolejnych dodawań są spłaszczane
+  do jednego węzła i liczone w jednym akumulatorze, a iloczyny będące
+  składnikami sumy są do niego dodawane bez budowania samego iloczynu.
+*/
+
+#ifndef _POLY_EXPR_H
+#define _POLY_EXPR_H
+
+#include "poly.h"
+
+/** Węzeł leniwego wyrażenia. */
+typedef struct PolyExpr PolyExpr;
+
+/**
+ * Tworzy wyrażenie o znanej wartości.
+ * Przejmuje na własność zawartość struktury wskazywanej przez @p p.
+ * @param[in] p : wielomian
+ * @return wyrażenie
+ */
+PolyExpr *PolyExprLeaf(Poly *p);
+
+/**
+ * Tworzy wyrażenie będące sumą dwóch wyrażeń.
+ * Przejmuje odwołania do @p a i @p b.
+ * @param[in] a : wyrażenie @f$a@f$
+ * @param[in] b : wyrażenie @f$b@f$
+ * @return wyrażenie @f$a + b@f$
+ */
+PolyExpr *PolyExprAdd(PolyExpr *a, PolyExpr *b);
+
+/**
+ * Tworzy wyrażenie będące różnicą dwóch wyrażeń.
+ * Przejmuje odwołania do @p a i @p b.
+ * @param[in] a : wyrażenie @f$a@f$
+ * @param[in] b : wyrażenie @f$b@f$
+ * @return wyrażenie @f$a - b@f$
+ */
+PolyExpr *PolyExprSub(PolyExpr *a, PolyExpr *b);
+
+/**
+ * Tworzy wyrażenie przeciwne do podanego.
+ * Przejmuje odwołanie do @p a.
+ * @param[in] a : wyrażenie @f$a@f$
+ * @return wyrażenie @f$-a@f$
+ */
+PolyExpr *PolyExprNeg(PolyExpr *a);
+
+/**
+ * Tworzy wyrażenie będące iloczynem dwóch wyrażeń.
+ * Przejmuje odwołania do @p a i @p b.
+ * @param[in] a : wyrażenie @f$a@f$
+ * @param[in] b : wyrażenie @f$b@f$
+ * @return wyrażenie @f$a \cdot b@f$
+ */
+PolyExpr *PolyExprMul(PolyExpr *a, PolyExpr *b);
+
+/**
+ * Daje nowe odwołanie do wyrażenia.
+ * @param[in] e : wyrażenie
+ * @return to samo wyrażenie
+ */
+PolyExpr *PolyExprRetain(PolyExpr *e);
+
+/**
+ * Zwalnia odwołanie do wyrażenia. Ostatnie zwolnienie usuwa węzeł
+ * z pamięci.
+ * @param[in] e : wyrażenie
+ */
+void PolyExprRelease(PolyExpr *e);
+
+/**
+ * Oblicza wartość wyrażenia i zwalnia odwołanie do niego.
+ * @param[in] e : wyrażenie
+ * @return wartość wyrażenia
+ */
+Poly PolyExprEval(PolyExpr *e);
+
+#endif //_POLY_EXPR_H
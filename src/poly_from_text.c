@@ -9,16 +9,17 @@
 #include "poly.h"
 #include <stdbool.h>
 #include <assert.h>
-#include <errno.h>
+#include <limits.h>
+#include <string.h>
 #include "poly_from_text.h"
+#include "monos.h"
+#include "poly_trace.h"
 
 #define MIN_EXP_VALUE 0
 #define MAX_EXP_VALUE 2147483647
 #define COEFF 0
 #define EXP 1
 
-extern int errno;
-
 bool isNumber (char c) {
     return (c >= '0' && c <= '9');
 }
@@ -40,11 +41,54 @@ bool isLetter (char c) {
     return ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z'));
 }
 
+bool readLong(char **current_char, long *res) {
+    char *c = *current_char;
+    bool negative = *c == '-';
+    if (negative)
+        c++;
+    if (!isNumber(*c))
+        return false;
+    // liczbę ujemną liczymy od razu ze znakiem, bo -LONG_MIN nie mieści się w long
+    long n = 0;
+    while (isNumber(*c)) {
+        int digit = *c - '0';
+        if (negative ? n < (LONG_MIN + digit) / 10 : n > (LONG_MAX - digit) / 10)
+            return false;
+        n = 10 * n + (negative ? -digit : digit);
+        c++;
+    }
+    *res = n;
+    *current_char = c;
+    return true;
+}
+
+bool readUnsignedLong(char **current_char, unsigned long *res) {
+    char *c = *current_char;
+    bool negative = *c == '-';
+    if (negative)
+        c++;
+    if (!isNumber(*c))
+        return false;
+    unsigned long n = 0;
+    while (isNumber(*c)) {
+        unsigned digit = *c - '0';
+        if (n > (ULONG_MAX - digit) / 10)
+            return false;
+        n = 10 * n + digit;
+        c++;
+    }
+    if (negative && n != 0) //-0
+        return false;
+    *res = n;
+    *current_char = c;
+    return true;
+}
+
 long toNumber (char **current_char, int number_type, bool *success) {
     assert(number_type == COEFF || number_type == EXP);
-    char *after_number_char;
-    long res = strtol(*current_char, &after_number_char, 10);
-    if (after_number_char == *current_char) {
+    char *after_number_char = *current_char;
+    long res;
+    if (!readLong(&after_number_char, &res)) {
         *success = false;
         return -1;
     }
@@ -58,14 +102,13 @@ long toNumber (char **current_char, int number_type, bool *success) {
 }
 
 /**
- * Wypisuje błąd parsowania wielomianu i usuwa z niego wszytskie elementy
+ * Kończy parsowanie wielomianu niepowodzeniem i usuwa ze stosu wszystkie
+ * elementy. Błąd zgłasza wywołujący.
  * @param[in] st : stos
- * @param[in] line_nr : numer obecnie przetwarzanego wiersza
  * @param[in] succ : wskaźnik na zmienną logiczną
  * oznaczającą (nie)powodzenie parsowania wielomianu
  */
-void reportError(Stack *st, long line_nr, bool *succ) {
-    fprintf(stderr, "ERROR %ld WRONG POLY\n", line_nr);
+static void parseFailed(Stack *st, bool *succ) {
     freeStack(st);
     *succ = false;
 }
@@ -139,8 +182,21 @@ bool isOpenBracket(Element *e) {
     return elementEqChar(e, '(');
 }
 
+/**
+ * Usuwa z pamięci jednomiany z tablicy i samą tablicę.
+ * @param[in] arr : tablica jednomianów
+ * @param[in] count : liczba jednomianów
+ */
+static void destroyMonos(Mono *arr, long count) {
+    for (long i = 0; i < count; i++)
+        MonoDestroy(&arr[i]);
+    free(arr);
+}
+
 /**
  * Dodaje jednomiany ze stosu aż do napotkania znaku '(' lub błędnego zapisu.
+ * Jednomiany są zdejmowane ze stosu od ostatniego, więc jednomiany
+ * wypisanego wielomianu trafiają do tablicy już posortowane.
  * W przypadku sukcesu wrzuca jednomian będący sumą tych wielomianów na stos.
  * @param[in] st : stos
  * @param[in] succ : wskaźnik na zmienną logiczną
@@ -151,6 +207,7 @@ void addMonosFromStack(Stack *st, bool *success) {
     Element *e = top(st);
 
     if (!success || e == NULL) {
+        MonoDestroy(&m);
         *success = false;
         return;
     }
@@ -166,10 +223,12 @@ void addMonosFromStack(Stack *st, bool *success) {
     while (!isOpenBracket(e) && !isEmpty(st)) {
         takeChar(st, '+', success);
         if (!*success) {
+            destroyMonos(arr, count);
             return;
         }
         m = takeMono(st, success);
         if (!*success) {
+            destroyMonos(arr, count);
             return;
         }
 
@@ -185,6 +244,7 @@ void addMonosFromStack(Stack *st, bool *success) {
         e = top(st);
         if (e == NULL) {
             *success = false;
+            destroyMonos(arr, count);
             return;
         }
     }
@@ -217,10 +277,12 @@ Poly addMonosFinal(Stack *st, bool *success) {
     while (!isEmpty(st)) {
         takeChar(st, '+', success);
         if (!*success) {
+            destroyMonos(arr, count);
             return PolyZero();
         }
         m = takeMono(st, success);
         if (!*success) {
+            destroyMonos(arr, count);
             return PolyZero();
         }
         arr[count] = m;
@@ -232,13 +294,21 @@ Poly addMonosFinal(Stack *st, bool *success) {
     return p;
 }
 
-Poly stringToPoly(Stack *st, char *current_char, long line_nr, bool *succ) {
+/**
+ * Konwertuje podany string na wielomian (właściwe parsowanie, bez śledzenia).
+ * @param[in] st : stos
+ * @param[in] current_char : wskaźnik na znak, od którego rozpoczynamy konwersję
+ * @param[in] succ : wskaźnik na zmienną logiczną
+ * ustawianą w zależności od tego, czy parsowanie powiodło się
+ * @return Wielomian zapisany w wierszu lub wielomian zerowy.
+ */
+static Poly parsePoly(Stack *st, char *current_char, bool *succ) {
     bool success = true;
     int num_type = COEFF;
     while (*current_char != '\n' && *current_char != 0) {
         char c = *current_char;
         if (!isLegal(c)) {
-            reportError(st, line_nr, succ);
+            parseFailed(st, succ);
             return PolyZero();
         }
         if (c == '('  || c == '+') {
@@ -250,7 +320,7 @@ Poly stringToPoly(Stack *st, char *current_char, long line_nr, bool *succ) {
         else if (c == ',') {
             num_type = EXP;
             if (isEmpty(st)) {
-                reportError(st, line_nr, succ);
+                parseFailed(st, succ);
                 return PolyZero();
             }
             Element *e = top(st);
@@ -264,7 +334,7 @@ Poly stringToPoly(Stack *st, char *current_char, long line_nr, bool *succ) {
             else {
                 addMonosFromStack(st, &success);
                 if (!success) {
-                    reportError(st, line_nr, succ);
+                    parseFailed(st, succ);
                     return PolyZero();
                 }
             }
@@ -274,8 +344,8 @@ Poly stringToPoly(Stack *st, char *current_char, long line_nr, bool *succ) {
         }
         else if (isNumberStart(c)) {
             long l = toNumber(&current_char, num_type, &success);
-            if (errno == ERANGE || !success) {
-                reportError(st, line_nr, succ);
+            if (!success) {
+                parseFailed(st, succ);
                 return PolyZero();
             }
 
@@ -289,7 +359,7 @@ Poly stringToPoly(Stack *st, char *current_char, long line_nr, bool *succ) {
 
             Element *e = top(st);
             if (!success || e == NULL) {
-                reportError(st, line_nr, succ);
+                parseFailed(st, succ);
                 return PolyZero();
             }
 
@@ -298,7 +368,7 @@ Poly stringToPoly(Stack *st, char *current_char, long line_nr, bool *succ) {
                 takeChar(st, '(', &success);
 
                 if (!success) {
-                    reportError(st, line_nr, succ);
+                    parseFailed(st, succ);
                     return PolyZero();
                 }
                 long n = e->n;
@@ -314,7 +384,8 @@ Poly stringToPoly(Stack *st, char *current_char, long line_nr, bool *succ) {
                 pop(st);
                 takeChar(st, '(', &success);
                 if (!success) {
-                    reportError(st, line_nr, succ);
+                    PolyDestroy(&p);
+                    parseFailed(st, succ);
                     return PolyZero();
                 }
 
@@ -326,20 +397,20 @@ Poly stringToPoly(Stack *st, char *current_char, long line_nr, bool *succ) {
                 push(st, e2);
             }
             else {
-                    reportError(st, line_nr, succ);
+                    parseFailed(st, succ);
                     return PolyZero();
             }
             current_char++;
         }
         else {
-            reportError(st, line_nr, succ);
+            parseFailed(st, succ);
             return PolyZero();
         }
     }
 
     Element *e = top(st);
     if (e == NULL) {
-        reportError(st, line_nr, succ);
+        parseFailed(st, succ);
         return PolyZero();
     }
 
@@ -354,12 +425,20 @@ Poly stringToPoly(Stack *st, char *current_char, long line_nr, bool *succ) {
         if (success)
             return p;
         else {
-            reportError(st, line_nr, succ);
+            parseFailed(st, succ);
             return PolyZero();
         }
     }
     else {
-        reportError(st, line_nr, succ);
+        parseFailed(st, succ);
         return PolyZero();
     }
+}
+
+Poly stringToPoly(Stack *st, char *current_char, bool *succ) {
+    uint64_t start = TraceBegin();
+    size_t length = start != 0 ? strlen(current_char) : 0;
+    Poly p = parsePoly(st, current_char, succ);
+    TraceEnd("parse", start, length, MonosOfPoly(&p));
+    return p;
 }
\ No newline at end of file
@@ -11,7 +11,6 @@
 #include <stddef.h>
 #include "poly.h"
 #include "stack.h"
-#include <errno.h>
 
 #define MIN_EXP_VALUE 0
 #define MAX_EXP_VALUE 2147483647
@@ -39,6 +38,27 @@ bool isNumberStart (char c);
  */
 bool isLetter (char c);
 
+/**
+ * Czyta liczbę całkowitą zapisaną dziesiętnie, z opcjonalnym minusem.
+ * W przeciwieństwie do strtol nie korzysta z errno, więc wynik nie zależy
+ * od stanu pozostawionego przez wcześniejsze wywołania.
+ * @param[in,out] current_char : wskaźnik na początek liczby, po udanym
+ * odczycie przesuwany za liczbę
+ * @param[out] res : odczytana liczba
+ * @return Czy odczytano liczbę mieszczącą się w typie long?
+ */
+bool readLong(char **current_char, long *res);
+
+/**
+ * Czyta nieujemną liczbę całkowitą zapisaną dziesiętnie. Dopuszcza zapis
+ * zera z minusem (-0), tak jak strtoul.
+ * @param[in,out] current_char : wskaźnik na początek liczby, po udanym
+ * odczycie przesuwany za liczbę
+ * @param[out] res : odczytana liczba
+ * @return Czy odczytano liczbę mieszczącą się w typie unsigned long?
+ */
+bool readUnsignedLong(char **current_char, unsigned long *res);
+
 /**
  * Konwertuje podany string na liczbę całkowitą.
  * @param[in] current_char : wskaźnik do stringa
@@ -51,13 +71,13 @@ long toNumber (char **current_char, int number_type, bool *success);
 
 /**
  * Konwertuje podany string na wielomian zgodnie z opisanymi założeniami kalkulatora.
+ * Nie wypisuje komunikatu o błędzie.
  * @param[in] st : stos
  * @param[in] current_char : wskaźnik na znak, od którego rozpoczynamy konwersję
- * @param[in] line_nr : numer obecnie przetwarzanego wiersza
  * @param[in] succ : wskaźnik na zmienną logiczną
  * ustawianą w zależności od tego, czy parsowanie powiodło się
  * @return Wielomian zapisany w wierszu, jeśli zawiera on poprawny zapis wielomianu, wielomian zerowy wpp.
  */
-Poly stringToPoly(Stack *st, char *current_char, long line_nr, bool *succ);
+Poly stringToPoly(Stack *st, char *current_char, bool *succ);
 
 #endif //_POLY_FROM_TEXT_H
\ No newline at end of file
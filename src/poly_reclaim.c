@@ -0,0 +1,143 @@
+/** @file
+  Implementacja odroczonego usuwania dużych wielomianów.
+*/
+
+#include <stdlib.h>
+#include <pthread.h>
+#include "poly_reclaim.h"
+#include "monos.h"
+
+/**
+ * Struktura przechowująca wielomian czekający na usunięcie.
+ */
+typedef struct ReclaimItem {
+    Poly p;                   ///< wielomian
+    size_t bytes;             ///< szacowana pamięć zajmowana przez wielomian
+    MonosBudget *budget;      ///< budżet, w którym przydzielono wielomian
+    struct ReclaimItem *next; ///< następny wielomian w kolejce
+} ReclaimItem;
+
+/**
+ * Struktura przechowująca stan odroczonego usuwania.
+ */
+static struct {
+    bool enabled;           ///< czy odroczone usuwanie jest włączone
+    bool stop;              ///< czy wątek usuwający ma się zakończyć
+    size_t max_pending;     ///< limit pamięci czekających wielomianów
+    size_t pending;         ///< pamięć czekających wielomianów
+    ReclaimItem *head;      ///< pierwszy wielomian w kolejce
+    ReclaimItem *tail;      ///< ostatni wielomian w kolejce
+    pthread_t thread;       ///< wątek usuwający
+    pthread_mutex_t lock;   ///< blokada chroniąca kolejkę
+    pthread_cond_t wake;    ///< sygnalizuje nowe wielomiany w kolejce
+    pthread_cond_t idle;    ///< sygnalizuje usunięcie wszystkich wielomianów
+} reclaim = {.lock = PTHREAD_MUTEX_INITIALIZER, .wake = PTHREAD_COND_INITIALIZER,
+             .idle = PTHREAD_COND_INITIALIZER};
+
+/**
+ * Szacuje pamięć zajmowaną przez wielomian na podstawie liczby
+ * jednomianów zapamiętanej w nagłówku.
+ * @param[in] p : wielomian niebędący współczynnikiem
+ * @return liczba bajtów
+ */
+static size_t reclaimBytes(const Poly *p) {
+    return MonosGetHeader(p->arr)->monos * (sizeof(Mono) + sizeof(poly_exp_t));
+}
+
+/**
+ * Funkcja wątku usuwającego: usuwa wielomiany z kolejki, aż do
+ * zatrzymania i opróżnienia kolejki.
+ * @param[in] arg : nieużywany
+ * @return NULL
+ */
+static void *reclaimRun(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&reclaim.lock);
+    for (;;) {
+        while (reclaim.head == NULL && !reclaim.stop)
+            pthread_cond_wait(&reclaim.wake, &reclaim.lock);
+        if (reclaim.head == NULL)
+            break;
+        ReclaimItem *item = reclaim.head;
+        reclaim.head = item->next;
+        if (reclaim.head == NULL)
+            reclaim.tail = NULL;
+        pthread_mutex_unlock(&reclaim.lock);
+
+        MonosUseBudget(item->budget);
+        PolyDestroy(&item->p);
+
+        pthread_mutex_lock(&reclaim.lock);
+        reclaim.pending -= item->bytes;
+        if (reclaim.pending == 0)
+            pthread_cond_broadcast(&reclaim.idle);
+        free(item);
+    }
+    pthread_mutex_unlock(&reclaim.lock);
+    MonosPoolRelease();
+    return NULL;
+}
+
+void PolyReclaimInit(size_t max_pending) {
+    PolyReclaimDestroy();
+    if (max_pending == 0)
+        return;
+    reclaim.max_pending = max_pending;
+    reclaim.stop = false;
+    if (pthread_create(&reclaim.thread, NULL, reclaimRun, NULL) != 0)
+        return;
+    reclaim.enabled = true;
+}
+
+bool PolyReclaimEnabled(void) {
+    return reclaim.enabled;
+}
+
+void PolyReclaim(Poly *p) {
+    // zamrożony wielomian jest zwalniany jednym wywołaniem free
+    if (!reclaim.enabled || PolyIsCoeff(p) || PolyIsFrozen(p)
+        || MonosGetHeader(p->arr)->monos < RECLAIM_MIN_MONOS) {
+        PolyDestroy(p);
+        return;
+    }
+    size_t bytes = reclaimBytes(p);
+    pthread_mutex_lock(&reclaim.lock);
+    if (reclaim.pending + bytes > reclaim.max_pending) {
+        pthread_mutex_unlock(&reclaim.lock);
+        PolyDestroy(p);
+        return;
+    }
+    ReclaimItem *item = malloc(sizeof(ReclaimItem));
+    if (item == NULL)
+        exit(1);
+    *item = (ReclaimItem) {.p = *p, .bytes = bytes, .budget = MonosGetContext().budget,
+                           .next = NULL};
+    if (reclaim.tail != NULL)
+        reclaim.tail->next = item;
+    else
+        reclaim.head = item;
+    reclaim.tail = item;
+    reclaim.pending += bytes;
+    pthread_cond_signal(&reclaim.wake);
+    pthread_mutex_unlock(&reclaim.lock);
+    *p = PolyZero();
+}
+
+void PolyReclaimWait(void) {
+    pthread_mutex_lock(&reclaim.lock);
+    while (reclaim.pending > 0)
+        pthread_cond_wait(&reclaim.idle, &reclaim.lock);
+    pthread_mutex_unlock(&reclaim.lock);
+}
+
+void PolyReclaimDestroy(void) {
+    if (!reclaim.enabled)
+        return;
+    pthread_mutex_lock(&reclaim.lock);
+    reclaim.stop = true;
+    pthread_cond_signal(&reclaim.wake);
+    pthread_mutex_unlock(&reclaim.lock);
+    pthread_join(reclaim.thread, NULL);
+    reclaim.enabled = false;
+    reclaim.max_pending = 0;
+}
@@ -0,0 +1,56 @@
+/** @file
+  Interfejs odroczonego usuwania dużych wielomianów.
+
+  Usuwanie wielomianu zajmującego gigabajty trwa długo i wliczało się do
+  czasu wykonania instrukcji, która go zdjęła ze stosu. Po włączeniu
+  odroczonego usuwania duże wielomiany są przekazywane do osobnego wątku,
+  który zwalnia je w tle. Łączny rozmiar wielomianów czekających na
+  usunięcie jest ograniczony; po przekroczeniu limitu wielomian jest
+  usuwany od razu.
+*/
+
+#ifndef _POLY_RECLAIM_H
+#define _POLY_RECLAIM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "poly.h"
+
+/** Najmniejsza liczba jednomianów wielomianu usuwanego w tle. */
+#define RECLAIM_MIN_MONOS 4096
+
+/**
+ * Włącza odroczone usuwanie wielomianów i uruchamia wątek usuwający.
+ * Limit równy 0 wyłącza odroczone usuwanie.
+ * @param[in] max_pending : limit pamięci wielomianów czekających na usunięcie
+ */
+void PolyReclaimInit(size_t max_pending);
+
+/**
+ * Sprawdza, czy odroczone usuwanie jest włączone.
+ * @return Czy odroczone usuwanie jest włączone?
+ */
+bool PolyReclaimEnabled(void);
+
+/**
+ * Usuwa wielomian z pamięci: duży wielomian przekazuje do usunięcia w tle,
+ * mały usuwa od razu. Przejmuje na własność zawartość struktury
+ * wskazywanej przez @p p.
+ * @param[in] p : wielomian
+ */
+void PolyReclaim(Poly *p);
+
+/**
+ * Czeka na usunięcie wszystkich przekazanych dotąd wielomianów. Wielomian
+ * jest usuwany w budżecie pamięci (MonosUseBudget), w którym został
+ * przekazany, więc przed usunięciem budżetu trzeba wywołać tę funkcję.
+ */
+void PolyReclaimWait(void);
+
+/**
+ * Czeka na usunięcie wszystkich przekazanych wielomianów, zatrzymuje
+ * wątek usuwający i wyłącza odroczone usuwanie.
+ */
+void PolyReclaimDestroy(void);
+
+#endif //_POLY_RECLAIM_H
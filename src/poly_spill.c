@@ -0,0 +1,191 @@
+/** @file
+  Implementacja wyrzucania wielomianów do pliku tymczasowego.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include "poly_spill.h"
+#include "monos.h"
+
+bool PolySpillInit(PolySpill *spill) {
+    spill->file = tmpfile();
+    spill->end = 0;
+    spill->live = 0;
+    spill->holes = NULL;
+    spill->holes_count = 0;
+    spill->holes_capacity = 0;
+    return spill->file != NULL;
+}
+
+/**
+ * Wybiera miejsce w pliku na blok: pierwszy wystarczająco duży wolny
+ * fragment albo koniec pliku.
+ * @param[in] spill : stan pliku
+ * @param[in] bytes : rozmiar bloku
+ * @param[out] hole : numer wybranego fragmentu lub liczba fragmentów,
+ * jeśli blok ma trafić na koniec pliku
+ * @return położenie bloku
+ */
+static uint64_t spillPlace(const PolySpill *spill, uint64_t bytes, size_t *hole) {
+    for (size_t i = 0; i < spill->holes_count; i++) {
+        if (spill->holes[i].bytes >= bytes) {
+            *hole = i;
+            return spill->holes[i].offset;
+        }
+    }
+    *hole = spill->holes_count;
+    return spill->end;
+}
+
+/**
+ * Zajmuje miejsce wybrane przez spillPlace.
+ * @param[in] spill : stan pliku
+ * @param[in] bytes : rozmiar bloku
+ * @param[in] hole : numer fragmentu wybranego przez spillPlace
+ */
+static void spillTake(PolySpill *spill, uint64_t bytes, size_t hole) {
+    if (hole == spill->holes_count) {
+        spill->end += bytes;
+        return;
+    }
+    SpillExtent *h = &spill->holes[hole];
+    h->offset += bytes;
+    h->bytes -= bytes;
+    if (h->bytes == 0) {
+        memmove(h, h + 1, (spill->holes_count - hole - 1) * sizeof(SpillExtent));
+        spill->holes_count--;
+    }
+}
+
+/**
+ * Zwalnia miejsce bloku w pliku, łącząc je z sąsiednimi wolnymi
+ * fragmentami. Wolny koniec pliku jest obcinany.
+ * @param[in] spill : stan pliku
+ * @param[in] offset : położenie bloku
+ * @param[in] bytes : rozmiar bloku
+ */
+static void spillRelease(PolySpill *spill, uint64_t offset, uint64_t bytes) {
+    size_t i = 0;
+    while (i < spill->holes_count && spill->holes[i].offset < offset)
+        i++;
+    bool join_prev = i > 0 && spill->holes[i - 1].offset + spill->holes[i - 1].bytes == offset;
+    bool join_next = i < spill->holes_count && offset + bytes == spill->holes[i].offset;
+    if (join_prev && join_next) {
+        spill->holes[i - 1].bytes += bytes + spill->holes[i].bytes;
+        memmove(&spill->holes[i], &spill->holes[i + 1],
+                (spill->holes_count - i - 1) * sizeof(SpillExtent));
+        spill->holes_count--;
+        i--;
+    }
+    else if (join_prev) {
+        spill->holes[--i].bytes += bytes;
+    }
+    else if (join_next) {
+        spill->holes[i].offset = offset;
+        spill->holes[i].bytes += bytes;
+    }
+    else {
+        if (spill->holes_count == spill->holes_capacity) {
+            spill->holes_capacity = spill->holes_capacity == 0 ? 16 : 2 * spill->holes_capacity;
+            spill->holes = realloc(spill->holes, spill->holes_capacity * sizeof(SpillExtent));
+            if (spill->holes == NULL)
+                exit(1);
+        }
+        memmove(&spill->holes[i + 1], &spill->holes[i],
+                (spill->holes_count - i) * sizeof(SpillExtent));
+        spill->holes[i] = (SpillExtent) {.offset = offset, .bytes = bytes};
+        spill->holes_count++;
+    }
+
+    // ostatni wolny fragment sięgający końca pliku jest odcinany
+    SpillExtent *h = &spill->holes[i];
+    if (i + 1 == spill->holes_count && h->offset + h->bytes == spill->end
+        && ftruncate(fileno(spill->file), (off_t)h->offset) == 0) {
+        spill->end = h->offset;
+        spill->holes_count--;
+    }
+}
+
+/**
+ * Zapisuje cały bufor w pliku tymczasowym.
+ * @param[in] spill : stan pliku
+ * @param[in] buf : bufor
+ * @param[in] bytes : rozmiar bufora
+ * @param[in] offset : położenie w pliku
+ * @return Czy zapis się powiódł?
+ */
+static bool spillPwrite(PolySpill *spill, const char *buf, size_t bytes, uint64_t offset) {
+    int fd = fileno(spill->file);
+    while (bytes > 0) {
+        ssize_t n = pwrite(fd, buf, bytes, (off_t)offset);
+        if (n <= 0)
+            return false;
+        buf += n;
+        bytes -= (size_t)n;
+        offset += (uint64_t)n;
+    }
+    return true;
+}
+
+bool PolySpillWrite(PolySpill *spill, Poly *p, SpillRecord *r) {
+    assert(spill->file != NULL && !PolyIsCoeff(p));
+    PolyFreeze(p);
+    char *block = (char *)MonosGetHeader(p->arr);
+    size_t bytes = MonosBytesOfPoly(p);
+    // blok odwzorowanego punktu kontrolnego jest przesuwany w kopii,
+    // żeby nie kopiować jego stron przy zapisie
+    char *buf = block;
+    if (MonosGetHeader(p->arr)->mapped) {
+        buf = malloc(bytes);
+        if (buf == NULL)
+            exit(1);
+        memcpy(buf, block, bytes);
+    }
+    MonosRelocateFrozen(buf, bytes, -(uintptr_t)block, false);
+    size_t hole;
+    uint64_t offset = spillPlace(spill, bytes, &hole);
+    bool ok = spillPwrite(spill, buf, bytes, offset);
+    if (buf != block)
+        free(buf);
+    else if (!ok)
+        MonosRelocateFrozen(buf, bytes, (uintptr_t)block, false);
+    if (!ok)
+        return false;
+
+    *r = (SpillRecord) {.offset = offset, .bytes = bytes, .monos = MonosOfPoly(p)};
+    spillTake(spill, bytes, hole);
+    spill->live += bytes;
+    PolyDestroy(p);
+    return true;
+}
+
+Poly PolySpillRead(PolySpill *spill, const SpillRecord *r) {
+    char *block = MonosAllocFrozen(r->bytes);
+    int fd = fileno(spill->file);
+    for (size_t done = 0; done < r->bytes;) {
+        ssize_t n = pread(fd, block + done, r->bytes - done, (off_t)(r->offset + done));
+        if (n <= 0)
+            exit(1);
+        done += (size_t)n;
+    }
+    MonosRelocateFrozen(block, r->bytes, (uintptr_t)block, false);
+    MonosHeader *h = (MonosHeader *)block;
+    spill->live -= r->bytes;
+    spillRelease(spill, r->offset, r->bytes);
+    return (Poly) {.size = h->capacity, .arr = (Mono *)(h + 1)};
+}
+
+void PolySpillDestroy(PolySpill *spill) {
+    if (spill->file != NULL)
+        fclose(spill->file);
+    spill->file = NULL;
+    free(spill->holes);
+    spill->holes = NULL;
+    spill->holes_count = 0;
+    spill->holes_capacity = 0;
+}
@@ -0,0 +1,87 @@
+/** @file
+  Interfejs wyrzucania wielomianów do pliku tymczasowego.
+
+  Wyrzucany wielomian jest zamrażany, a jego blok jest zapisywany w pliku
+  ze wskaźnikami zamienionymi na przesunięcia względem początku bloku.
+  Taki zapis nie zawiera pustych miejsc ani narzutu osobnych przydziałów
+  pamięci i jest wczytywany z powrotem jednym odczytem do jednego bloku.
+  Miejsce po wczytanym wielomianie trafia na listę wolnych fragmentów
+  pliku i jest wykorzystywane przez kolejne zapisy, a wolny koniec pliku
+  jest obcinany. Plik nie rośnie więc, gdy te same wielomiany są
+  wielokrotnie wyrzucane i wczytywane.
+
+  Każdy kalkulator ma własny plik tymczasowy. Pliku może używać naraz
+  tylko jeden wątek.
+*/
+
+#ifndef _POLY_SPILL_H
+#define _POLY_SPILL_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdint.h>
+#include "poly.h"
+
+/**
+ * Struktura opisująca wielomian zapisany w pliku tymczasowym.
+ */
+typedef struct SpillRecord {
+    uint64_t offset; ///< położenie bloku w pliku
+    uint64_t bytes;  ///< rozmiar bloku
+    size_t monos;    ///< łączna liczba jednomianów wielomianu
+} SpillRecord;
+
+/**
+ * Struktura opisująca wolny fragment pliku tymczasowego.
+ */
+typedef struct SpillExtent {
+    uint64_t offset; ///< położenie fragmentu w pliku
+    uint64_t bytes;  ///< rozmiar fragmentu
+} SpillExtent;
+
+/**
+ * Struktura przechowująca stan pliku tymczasowego.
+ */
+typedef struct PolySpill {
+    FILE *file;         ///< plik tymczasowy lub NULL
+    uint64_t end;       ///< koniec zapisanej części pliku
+    uint64_t live;      ///< liczba bajtów wielomianów jeszcze niewczytanych
+    SpillExtent *holes; ///< wolne fragmenty przed końcem, rosnąco po położeniu
+    size_t holes_count; ///< liczba wolnych fragmentów
+    size_t holes_capacity; ///< pojemność tablicy wolnych fragmentów
+} PolySpill;
+
+/**
+ * Tworzy plik tymczasowy na wyrzucane wielomiany.
+ * @param[out] spill : stan pliku
+ * @return Czy udało się utworzyć plik?
+ */
+bool PolySpillInit(PolySpill *spill);
+
+/**
+ * Zapisuje wielomian w pliku tymczasowym i usuwa go z pamięci.
+ * Przejmuje na własność zawartość struktury wskazywanej przez @p p,
+ * jeśli zapis się powiedzie.
+ * @param[in] spill : stan pliku
+ * @param[in] p : wielomian niebędący współczynnikiem
+ * @param[out] r : opis zapisanego wielomianu
+ * @return Czy udało się zapisać wielomian?
+ */
+bool PolySpillWrite(PolySpill *spill, Poly *p, SpillRecord *r);
+
+/**
+ * Wczytuje wielomian z pliku tymczasowego. Wczytany wielomian jest
+ * zamrożony, a jego miejsce w pliku staje się wolne.
+ * @param[in] spill : stan pliku
+ * @param[in] r : opis zapisanego wielomianu
+ * @return wielomian
+ */
+Poly PolySpillRead(PolySpill *spill, const SpillRecord *r);
+
+/**
+ * Zamyka i usuwa plik tymczasowy.
+ * @param[in] spill : stan pliku
+ */
+void PolySpillDestroy(PolySpill *spill);
+
+#endif //_POLY_SPILL_H
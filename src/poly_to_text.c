@@ -2,25 +2,47 @@
 #include "poly.h"
 #include <stddef.h>
 #include "poly_to_text.h"
+#include "poly_walk.h"
 
-void printPoly(Poly *p) {
+void printPoly(FILE *out, Poly *p) {
     if (PolyIsCoeff(p)) {
         poly_coeff_t c = p->coeff;
-        printf("%ld", c);
+        fprintf(out, "%ld", c);
+        return;
     }
-    else {
-        for (size_t i = p->size - 1; i > 0; i--) {
-            printMono(&p->arr[i]);
-            printf("+");
+
+    PolyWalk w;
+    PolyWalkInit(&w);
+    PolyWalkPush(&w, p, NULL, NULL);
+    while (!PolyWalkIsEmpty(&w)) {
+        PolyWalkFrame *f = PolyWalkTop(&w);
+        if (f->i < f->p->size) {
+            // jednomiany wypisujemy od ostatniego do pierwszego
+            const Mono *m = &f->p->arr[f->p->size - 1 - f->i];
+            if (f->i > 0)
+                fprintf(out, "+");
+            f->i++;
+            fprintf(out, "(");
+            if (PolyIsCoeff(&m->p))
+                fprintf(out, "%ld,%d)", m->p.coeff, m->exp);
+            else
+                PolyWalkPush(&w, &m->p, NULL, NULL);
+        }
+        else {
+            PolyWalkPop(&w);
+            if (!PolyWalkIsEmpty(&w)) {
+                f = PolyWalkTop(&w);
+                fprintf(out, ",%d)", f->p->arr[f->p->size - f->i].exp);
+            }
         }
-        printMono(&p->arr[0]);
     }
+    PolyWalkFree(&w);
 }
 
-void printMono(Mono *m) {
-    printf("(");
-    printPoly(&m->p);
-    printf(",");
-    printf("%d", m->exp);
-    printf(")");
+void printMono(FILE *out, Mono *m) {
+    fprintf(out, "(");
+    printPoly(out, &m->p);
+    fprintf(out, ",");
+    fprintf(out, "%d", m->exp);
+    fprintf(out, ")");
 }
\ No newline at end of file
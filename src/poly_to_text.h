@@ -17,14 +17,16 @@
 
 /**
  * Wypisuje w odwrotnej notacji polskiej wielomian.
+ * @param[in] out : strumień wyjściowy
  * @param[in] p : wielomian @f$p@f$
  */
-void printPoly(Poly *p);
+void printPoly(FILE *out, Poly *p);
 
 /**
  * Wypisuje w odwrotnej notacji polskiej jednomian.
+ * @param[in] out : strumień wyjściowy
  * @param[in] m : jednomian @f$m@f$
  */
-void printMono(Mono *m);
+void printMono(FILE *out, Mono *m);
 
 #endif //_POLY_TO_TEXT_H
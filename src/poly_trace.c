@@ -0,0 +1,165 @@
+/** @file
+  Implementacja śledzenia zdarzeń kalkulatora.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <time.h>
+#include "poly_trace.h"
+
+/**
+ * Struktura przechowująca zdarzenie.
+ */
+typedef struct TraceEvent {
+    char name[TRACE_NAME_LENGTH + 1]; ///< nazwa zdarzenia
+    long line;                        ///< numer wiersza
+    uint64_t start;                   ///< chwila rozpoczęcia (ns)
+    uint64_t duration;                ///< czas trwania (ns)
+    size_t a;                         ///< rozmiar pierwszego argumentu
+    size_t b;                         ///< rozmiar drugiego argumentu
+} TraceEvent;
+
+/**
+ * Struktura przechowująca bufor cykliczny zdarzeń jednego wątku.
+ */
+typedef struct TraceBuffer {
+    TraceEvent events[TRACE_BUFFER_EVENTS]; ///< zdarzenia
+    uint64_t count;                         ///< liczba zapisanych zdarzeń
+    int tid;                                ///< numer wątku
+    struct TraceBuffer *next;               ///< bufor innego wątku
+} TraceBuffer;
+
+bool trace_enabled = false;
+
+/** Plik wynikowy. */
+static FILE *trace_file;
+
+/** Chwila włączenia śledzenia (ns). */
+static uint64_t trace_origin;
+
+/** Numer wiersza obsługiwanego przez bieżący wątek. */
+static _Thread_local long trace_line;
+
+/** Lista buforów wszystkich wątków. */
+static _Atomic(TraceBuffer *) trace_buffers;
+
+/** Liczba utworzonych buforów. */
+static atomic_int trace_threads;
+
+/** Bufor bieżącego wątku. */
+static _Thread_local TraceBuffer *trace_buffer;
+
+/**
+ * Daje bieżący czas zegara monotonicznego.
+ * @return czas w nanosekundach
+ */
+static uint64_t traceClock(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+bool TraceInit(const char *path) {
+    trace_file = fopen(path, "w");
+    if (trace_file == NULL)
+        return false;
+    trace_origin = traceClock();
+    trace_enabled = true;
+    return true;
+}
+
+long TraceSetLine(long line_nr) {
+    long old = trace_line;
+    trace_line = line_nr;
+    return old;
+}
+
+long TraceGetLine(void) {
+    return trace_line;
+}
+
+uint64_t TraceBeginSlow(void) {
+    // chwila 0 oznacza wyłączone śledzenie
+    return traceClock() - trace_origin + 1;
+}
+
+/**
+ * Daje bufor bieżącego wątku, tworząc go przy pierwszym użyciu.
+ * @return bufor zdarzeń
+ */
+static TraceBuffer *traceBuffer(void) {
+    if (trace_buffer != NULL)
+        return trace_buffer;
+    TraceBuffer *b = calloc(1, sizeof(TraceBuffer));
+    if (b == NULL)
+        exit(1);
+    b->tid = atomic_fetch_add(&trace_threads, 1) + 1;
+    b->next = atomic_load(&trace_buffers);
+    while (!atomic_compare_exchange_weak(&trace_buffers, &b->next, b))
+        ;
+    trace_buffer = b;
+    return b;
+}
+
+void TraceEnd(const char *name, uint64_t start, size_t a, size_t b) {
+    if (start == 0)
+        return;
+    uint64_t end = traceClock() - trace_origin + 1;
+    TraceBuffer *buf = traceBuffer();
+    TraceEvent *e = &buf->events[buf->count % TRACE_BUFFER_EVENTS];
+    strncpy(e->name, name, TRACE_NAME_LENGTH);
+    e->name[TRACE_NAME_LENGTH] = 0;
+    e->line = trace_line;
+    e->start = start - 1;
+    e->duration = end - start;
+    e->a = a;
+    e->b = b;
+    buf->count++;
+}
+
+/**
+ * Zapisuje zdarzenia jednego bufora.
+ * @param[in] buf : bufor zdarzeń
+ * @param[in,out] first : czy żadne zdarzenie nie zostało jeszcze zapisane
+ */
+static void traceWriteBuffer(const TraceBuffer *buf, bool *first) {
+    uint64_t from = buf->count > TRACE_BUFFER_EVENTS ? buf->count - TRACE_BUFFER_EVENTS : 0;
+    for (uint64_t i = from; i < buf->count; i++) {
+        const TraceEvent *e = &buf->events[i % TRACE_BUFFER_EVENTS];
+        fprintf(trace_file, "%s\n{\"name\":\"", *first ? "" : ",");
+        for (const char *c = e->name; *c != 0; c++) {
+            if (*c == '"' || *c == '\\')
+                fputc('\\', trace_file);
+            if ((unsigned char)*c >= ' ')
+                fputc(*c, trace_file);
+        }
+        fprintf(trace_file, "\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,"
+                "\"args\":{\"line\":%ld,\"a\":%zu,\"b\":%zu}}",
+                buf->tid, e->start / 1000.0, e->duration / 1000.0, e->line, e->a, e->b);
+        *first = false;
+    }
+}
+
+void TraceFinish(void) {
+    if (!trace_enabled)
+        return;
+    trace_enabled = false;
+    bool first = true;
+    fprintf(trace_file, "{\"traceEvents\":[");
+    TraceBuffer *buf = atomic_load(&trace_buffers);
+    while (buf != NULL) {
+        traceWriteBuffer(buf, &first);
+        TraceBuffer *next = buf->next;
+        free(buf);
+        buf = next;
+    }
+    fprintf(trace_file, "\n],\"displayTimeUnit\":\"ns\"}\n");
+    fclose(trace_file);
+    trace_file = NULL;
+    atomic_store(&trace_buffers, NULL);
+    trace_buffer = NULL;
+}
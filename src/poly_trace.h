@@ -0,0 +1,86 @@
+/** @file
+  Interfejs śledzenia zdarzeń kalkulatora.
+
+  Śledzenie jest opcjonalne (domyślnie wyłączone). Po włączeniu każda
+  wykonana instrukcja i ważniejsze etapy obliczeń (parsowanie wiersza,
+  sortowanie i scalanie jednomianów, mnożenie wielomianów) są zapisywane
+  jako zdarzenia z numerem wiersza, rozmiarami argumentów i czasem
+  trwania. Każdy wątek zapisuje zdarzenia do własnego bufora cyklicznego,
+  bez blokad; przy przepełnieniu najstarsze zdarzenia są nadpisywane.
+  Na koniec zdarzenia są zapisywane w formacie JSON Chrome Trace, który
+  można obejrzeć np. w Perfetto.
+*/
+
+#ifndef _POLY_TRACE_H
+#define _POLY_TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** Liczba zdarzeń mieszczących się w buforze jednego wątku. */
+#define TRACE_BUFFER_EVENTS 65536
+
+/** Największa długość nazwy zdarzenia. */
+#define TRACE_NAME_LENGTH 15
+
+/** Najmniejsza liczba jednomianów, od której etapy obliczeń są śledzone. */
+#define TRACE_MIN_MONOS 64
+
+/** Czy śledzenie jest włączone? */
+extern bool trace_enabled;
+
+/**
+ * Włącza śledzenie. Zdarzenia zostaną zapisane do podanego pliku
+ * przez TraceFinish.
+ * @param[in] path : ścieżka pliku wynikowego
+ * @return Czy udało się otworzyć plik?
+ */
+bool TraceInit(const char *path);
+
+/**
+ * Ustawia numer wiersza dołączany do kolejnych zdarzeń bieżącego wątku.
+ * Zadania wykonywane w imieniu wątku przez wątki puli (WorkGroupSpawn)
+ * przejmują jego numer wiersza.
+ * @param[in] line_nr : numer wiersza
+ * @return poprzedni numer wiersza
+ */
+long TraceSetLine(long line_nr);
+
+/**
+ * Daje numer wiersza dołączany do zdarzeń bieżącego wątku.
+ * @return numer wiersza
+ */
+long TraceGetLine(void);
+
+/**
+ * Rozpoczyna pomiar zdarzenia.
+ * @return chwila rozpoczęcia lub 0, jeśli śledzenie jest wyłączone
+ */
+uint64_t TraceBeginSlow(void);
+
+/**
+ * Rozpoczyna pomiar zdarzenia.
+ * @return chwila rozpoczęcia lub 0, jeśli śledzenie jest wyłączone
+ */
+static inline uint64_t TraceBegin(void) {
+    return trace_enabled ? TraceBeginSlow() : 0;
+}
+
+/**
+ * Zapisuje zdarzenie rozpoczęte przez TraceBegin. Nic nie robi, jeśli
+ * @p start jest równe 0.
+ * @param[in] name : nazwa zdarzenia
+ * @param[in] start : chwila rozpoczęcia
+ * @param[in] a : rozmiar pierwszego argumentu
+ * @param[in] b : rozmiar drugiego argumentu
+ */
+void TraceEnd(const char *name, uint64_t start, size_t a, size_t b);
+
+/**
+ * Zapisuje zebrane zdarzenia do pliku i wyłącza śledzenie.
+ * Wszystkie śledzone wątki muszą być już zakończone.
+ */
+void TraceFinish(void);
+
+#endif //_POLY_TRACE_H
@@ -0,0 +1,38 @@
+/** @file
+  Implementacja stosu roboczego do nierekurencyjnego przechodzenia wielomianów.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "poly_walk.h"
+
+void PolyWalkInit(PolyWalk *w) {
+    w->frames = w->local;
+    w->size = 0;
+    w->capacity = POLY_WALK_LOCAL_FRAMES;
+}
+
+void PolyWalkFree(PolyWalk *w) {
+    if (w->frames != w->local)
+        free(w->frames);
+    PolyWalkInit(w);
+}
+
+void PolyWalkPush(PolyWalk *w, const Poly *p, const Poly *q, Poly *res) {
+    if (w->size == w->capacity) {
+        PolyWalkFrame *frames;
+        if (w->frames == w->local) {
+            frames = malloc(2 * w->capacity * sizeof(PolyWalkFrame));
+            if (frames != NULL)
+                memcpy(frames, w->local, w->size * sizeof(PolyWalkFrame));
+        }
+        else {
+            frames = realloc(w->frames, 2 * w->capacity * sizeof(PolyWalkFrame));
+        }
+        if (frames == NULL)
+            exit(1);
+        w->frames = frames;
+        w->capacity *= 2;
+    }
+    w->frames[w->size++] = (PolyWalkFrame) {.p = p, .q = q, .res = res, .i = 0};
+}
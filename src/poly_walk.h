@@ -0,0 +1,90 @@
+/** @file
+  Interfejs stosu roboczego do nierekurencyjnego przechodzenia wielomianów.
+
+  Funkcje przechodzące drzewo wielomianu trzymają na tym stosie po jednej
+  ramce na każdy poziom zagnieżdżenia, zamiast wywoływać się rekurencyjnie.
+  Pierwsze ramki mieszczą się w samej strukturze, kolejne są przydzielane
+  na stercie, więc głęboko zagnieżdżone wielomiany nie przepełniają stosu
+  wywołań.
+*/
+
+#ifndef _POLY_WALK_H
+#define _POLY_WALK_H
+
+#include <stddef.h>
+#include "poly.h"
+
+/** Liczba ramek mieszczących się w strukturze stosu roboczego. */
+#define POLY_WALK_LOCAL_FRAMES 32
+
+/**
+ * Struktura przechowująca ramkę stosu roboczego, czyli stan przeglądania
+ * jednego wielomianu niebędącego współczynnikiem.
+ */
+typedef struct PolyWalkFrame {
+    const Poly *p; ///< przeglądany wielomian
+    const Poly *q; ///< wielomian przeglądany równolegle z @p p lub NULL
+    Poly *res;     ///< budowany lub usuwany wielomian lub NULL
+    size_t i;      ///< liczba odwiedzonych jednomianów
+} PolyWalkFrame;
+
+/**
+ * Struktura przechowująca stos roboczy.
+ */
+typedef struct PolyWalk {
+    PolyWalkFrame *frames; ///< ramki stosu
+    size_t size;           ///< liczba ramek na stosie
+    size_t capacity;       ///< pojemność tablicy ramek
+    PolyWalkFrame local[POLY_WALK_LOCAL_FRAMES]; ///< ramki w strukturze
+} PolyWalk;
+
+/**
+ * Inicjuje pusty stos roboczy.
+ * @param[in] w : stos roboczy
+ */
+void PolyWalkInit(PolyWalk *w);
+
+/**
+ * Zwalnia pamięć zajmowaną przez stos roboczy.
+ * @param[in] w : stos roboczy
+ */
+void PolyWalkFree(PolyWalk *w);
+
+/**
+ * Wrzuca na stos roboczy ramkę dla podanych wielomianów.
+ * Wskaźniki do ramek uzyskane wcześniej przez PolyWalkTop przestają
+ * być ważne.
+ * @param[in] w : stos roboczy
+ * @param[in] p : przeglądany wielomian
+ * @param[in] q : wielomian przeglądany równolegle lub NULL
+ * @param[in] res : budowany lub usuwany wielomian lub NULL
+ */
+void PolyWalkPush(PolyWalk *w, const Poly *p, const Poly *q, Poly *res);
+
+/**
+ * Daje ramkę z wierzchu stosu roboczego.
+ * @param[in] w : niepusty stos roboczy
+ * @return ramka z wierzchu stosu
+ */
+static inline PolyWalkFrame *PolyWalkTop(PolyWalk *w) {
+    return &w->frames[w->size - 1];
+}
+
+/**
+ * Usuwa ramkę z wierzchu stosu roboczego.
+ * @param[in] w : niepusty stos roboczy
+ */
+static inline void PolyWalkPop(PolyWalk *w) {
+    w->size--;
+}
+
+/**
+ * Sprawdza, czy stos roboczy jest pusty.
+ * @param[in] w : stos roboczy
+ * @return Czy stos roboczy jest pusty?
+ */
+static inline bool PolyWalkIsEmpty(const PolyWalk *w) {
+    return w->size == 0;
+}
+
+#endif //_POLY_WALK_H
@@ -0,0 +1,487 @@
+/** @file
+  Implementacja serwera kalkulatora na gnieździe uniksowym.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <poll.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "server.h"
+#include "monos.h"
+
+/** Liczba bajtów czytanych z połączenia jednym wywołaniem recv. */
+#define SERVER_READ_SIZE 4096
+
+/** Długość kolejki połączeń oczekujących na przyjęcie. */
+#define SERVER_BACKLOG 64
+
+/**
+ * Struktura przechowująca sesję, czyli jedno połączenie z kalkulatorem.
+ */
+typedef struct Session {
+    int fd;               ///< połączenie
+    Calculator *calc;     ///< kalkulator sesji
+    char *buf;            ///< odebrane, jeszcze niewykonane bajty
+    size_t len;           ///< liczba bajtów w buforze
+    size_t cap;           ///< pojemność bufora
+    double time;          ///< zużyty czas procesora w sekundach
+    bool closed;          ///< czy sesję trzeba zamknąć
+    struct Session *next; ///< następna sesja na liście
+} Session;
+
+/**
+ * Struktura przechowująca kolejkę sesji.
+ */
+typedef struct SessionQueue {
+    Session *head; ///< pierwsza sesja
+    Session *tail; ///< ostatnia sesja
+} SessionQueue;
+
+struct Server {
+    ServerConfig config;         ///< ustawienia
+    int listen_fd;               ///< gniazdo nasłuchujące
+    int wake[2];                 ///< łącze budzące wątek obserwujący połączenia
+    atomic_bool stop;            ///< czy serwer ma się zatrzymać
+    Session *idle;               ///< sesje czekające na dane (tylko wątek obserwujący)
+    SessionQueue ready;          ///< sesje z danymi czekające na wątek roboczy
+    SessionQueue done;           ///< sesje oddane przez wątki robocze
+    bool workers_stop;           ///< czy wątki robocze mają się zakończyć
+    pthread_mutex_t lock;        ///< blokada chroniąca kolejki i workers_stop
+    pthread_cond_t work;         ///< sygnalizuje sesje w kolejce ready
+    pthread_t *threads;          ///< wątki robocze
+    unsigned thread_count;       ///< liczba wątków roboczych
+};
+
+/**
+ * Wstawia sesję na koniec kolejki.
+ * @param[in] q : kolejka
+ * @param[in] s : sesja
+ */
+static void queuePush(SessionQueue *q, Session *s) {
+    s->next = NULL;
+    if (q->tail != NULL)
+        q->tail->next = s;
+    else
+        q->head = s;
+    q->tail = s;
+}
+
+/**
+ * Zdejmuje sesję z początku kolejki.
+ * @param[in] q : kolejka
+ * @return sesja lub NULL, jeśli kolejka jest pusta
+ */
+static Session *queuePop(SessionQueue *q) {
+    Session *s = q->head;
+    if (s != NULL) {
+        q->head = s->next;
+        if (q->head == NULL)
+            q->tail = NULL;
+    }
+    return s;
+}
+
+/**
+ * Daje czas procesora zużyty przez bieżący wątek.
+ * @return czas w sekundach
+ */
+static double threadTime(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Budzi wątek obserwujący połączenia.
+ * @param[in] server : serwer
+ */
+static void wakeDispatcher(Server *server) {
+    char c = 0;
+    ssize_t n = write(server->wake[1], &c, 1);
+    (void)n; // pełne łącze też obudzi wątek
+}
+
+/**
+ * Zamyka sesję i usuwa jej kalkulator.
+ * @param[in] s : sesja
+ */
+static void destroySession(Session *s) {
+    destroyCalculator(s->calc);
+    close(s->fd);
+    free(s->buf);
+    free(s);
+}
+
+/**
+ * Wysyła całą odpowiedź do klienta.
+ * @param[in] fd : połączenie
+ * @param[in] data : odpowiedź
+ * @param[in] len : długość odpowiedzi
+ * @return Czy udało się wysłać odpowiedź?
+ */
+static bool sendAll(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        data += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+/**
+ * Odbiera dane, które nadeszły połączeniem, nie czekając na kolejne.
+ * @param[in] server : serwer
+ * @param[in] s : sesja
+ * @return Czy klient zakończył wysyłanie danych?
+ */
+static bool receive(Server *server, Session *s) {
+    for (;;) {
+        if (s->cap - s->len < SERVER_READ_SIZE + 1) {
+            s->cap = 2 * s->cap + SERVER_READ_SIZE + 1;
+            s->buf = realloc(s->buf, s->cap);
+            if (s->buf == NULL)
+                exit(1);
+        }
+        ssize_t n = recv(s->fd, s->buf + s->len, SERVER_READ_SIZE, MSG_DONTWAIT);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            return errno != EAGAIN && errno != EWOULDBLOCK;
+        if (n == 0)
+            return true;
+        s->len += (size_t)n;
+        size_t limit = server->config.session_memory;
+        if (limit != 0 && s->len > limit)
+            return false; // przekroczenie zgłosi executeLines
+    }
+}
+
+/**
+ * Wykonuje wiersz sesji i sprawdza jej limity.
+ * @param[in] server : serwer
+ * @param[in] s : sesja
+ * @param[in] line : wiersz zakończony znakiem '\0'
+ * @param[in] length : długość wiersza
+ */
+static void executeLine(Server *server, Session *s, char *line, size_t length) {
+    double limit = server->config.session_time;
+    if (limit > 0)
+        setTimeLimit(s->calc, limit - s->time);
+    double start = threadTime();
+    int ret = takeLine(s->calc, line, length);
+    s->time += threadTime() - start;
+    if (limit > 0)
+        s->time += calculatorPoolTime(s->calc);
+    if (ret == CALC_TIME_LIMIT) {
+        // instrukcja została przerwana i już zgłosiła błąd
+        s->closed = true;
+    }
+    else if (limit > 0 && s->time > limit) {
+        calcError(s->calc, CALC_TIME_LIMIT);
+        s->closed = true;
+    }
+    else if (server->config.session_memory != 0
+             && calculatorBytes(s->calc) > server->config.session_memory) {
+        calcError(s->calc, CALC_MEMORY_LIMIT);
+        s->closed = true;
+    }
+}
+
+/**
+ * Wykonuje wszystkie pełne wiersze z bufora sesji, a jeśli klient
+ * zakończył wysyłanie danych, także ostatni niepełny wiersz.
+ * @param[in] server : serwer
+ * @param[in] s : sesja
+ * @param[in] eof : czy klient zakończył wysyłanie danych
+ */
+static void executeLines(Server *server, Session *s, bool eof) {
+    size_t start = 0;
+    while (!s->closed && start < s->len) {
+        char *nl = memchr(s->buf + start, '\n', s->len - start);
+        if (nl == NULL && !eof)
+            break;
+        size_t length = nl != NULL ? (size_t)(nl - (s->buf + start)) + 1 : s->len - start;
+        // bufor ma zawsze wolny bajt za danymi
+        char saved = s->buf[start + length];
+        s->buf[start + length] = '\0';
+        executeLine(server, s, s->buf + start, length);
+        s->buf[start + length] = saved;
+        start += length;
+    }
+    memmove(s->buf, s->buf + start, s->len - start);
+    s->len -= start;
+    size_t limit = server->config.session_memory;
+    if (!s->closed && limit != 0 && s->len > limit) {
+        calcError(s->calc, CALC_MEMORY_LIMIT);
+        s->closed = true;
+    }
+    if (eof)
+        s->closed = true;
+}
+
+/**
+ * Obsługuje dane, które nadeszły połączeniem sesji, i odsyła odpowiedź.
+ * @param[in] server : serwer
+ * @param[in] s : sesja
+ */
+static void serveSession(Server *server, Session *s) {
+    char *reply = NULL;
+    size_t reply_len = 0;
+    FILE *out = open_memstream(&reply, &reply_len);
+    if (out == NULL)
+        exit(1);
+    s->calc->out = out;
+    s->calc->err = out;
+    executeLines(server, s, receive(server, s));
+    s->calc->out = NULL;
+    s->calc->err = NULL;
+    fclose(out);
+    if (!sendAll(s->fd, reply, reply_len))
+        s->closed = true;
+    free(reply);
+}
+
+/**
+ * Funkcja wątku roboczego: obsługuje sesje z kolejki ready, aż do
+ * zatrzymania serwera i opróżnienia kolejki.
+ * @param[in] arg : serwer
+ * @return NULL
+ */
+static void *workerRun(void *arg) {
+    Server *server = arg;
+    pthread_mutex_lock(&server->lock);
+    for (;;) {
+        while (server->ready.head == NULL && !server->workers_stop)
+            pthread_cond_wait(&server->work, &server->lock);
+        Session *s = queuePop(&server->ready);
+        if (s == NULL)
+            break;
+        pthread_mutex_unlock(&server->lock);
+
+        serveSession(server, s);
+
+        pthread_mutex_lock(&server->lock);
+        queuePush(&server->done, s);
+        wakeDispatcher(server);
+    }
+    pthread_mutex_unlock(&server->lock);
+    MonosPoolRelease();
+    return NULL;
+}
+
+/**
+ * Ustawia deskryptor w tryb nieblokujący.
+ * @param[in] fd : deskryptor
+ * @return Czy się udało?
+ */
+static bool setNonBlocking(int fd) {
+    int flags = fcntl(fd, F_GETFL);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+Server *makeServer(const ServerConfig *config) {
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    if (strlen(config->path) >= sizeof(addr.sun_path)) {
+        errno = ENAMETOOLONG;
+        return NULL;
+    }
+    strcpy(addr.sun_path, config->path);
+    struct stat sb;
+    if (stat(config->path, &sb) == 0 && S_ISSOCK(sb.st_mode))
+        unlink(config->path);
+
+    Server *server = calloc(1, sizeof(Server));
+    if (server == NULL)
+        exit(1);
+    server->config = *config;
+    server->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server->listen_fd < 0) {
+        free(server);
+        return NULL;
+    }
+    if (bind(server->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0
+        || listen(server->listen_fd, SERVER_BACKLOG) != 0
+        || !setNonBlocking(server->listen_fd)
+        || pipe(server->wake) != 0) {
+        int err = errno;
+        close(server->listen_fd);
+        free(server);
+        errno = err;
+        return NULL;
+    }
+    setNonBlocking(server->wake[0]);
+    setNonBlocking(server->wake[1]);
+    pthread_mutex_init(&server->lock, NULL);
+    pthread_cond_init(&server->work, NULL);
+    return server;
+}
+
+/**
+ * Przyjmuje nowe połączenie i tworzy dla niego sesję.
+ * @param[in] server : serwer
+ */
+static void acceptSession(Server *server) {
+    int fd = accept(server->listen_fd, NULL, NULL);
+    if (fd < 0)
+        return;
+    Session *s = calloc(1, sizeof(Session));
+    if (s == NULL)
+        exit(1);
+    s->fd = fd;
+    s->calc = makeCalculator(NULL, NULL);
+    // klient nie może zapisywać plików z uprawnieniami serwera
+    setCheckpoints(s->calc, false);
+    if (configureCalculator(s->calc, &server->config.calc) != CALC_OK) {
+        destroySession(s);
+        return;
+    }
+    // instrukcja, która sama przekroczyłaby limit pamięci sesji, jest
+    // przerywana w trakcie wykonywania
+    size_t memory = server->config.calc.memory;
+    size_t session_memory = server->config.session_memory;
+    if (session_memory != 0 && (memory == 0 || session_memory < memory))
+        setMemoryLimit(s->calc, session_memory);
+    s->next = server->idle;
+    server->idle = s;
+}
+
+/**
+ * Uruchamia wątki robocze.
+ * @param[in] server : serwer
+ */
+static void startWorkers(Server *server) {
+    unsigned count = server->config.workers;
+    if (count == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        count = cpus > 0 ? (unsigned)cpus : 1;
+    }
+    server->threads = malloc(count * sizeof(pthread_t));
+    if (server->threads == NULL)
+        exit(1);
+    for (unsigned i = 0; i < count; i++) {
+        if (pthread_create(&server->threads[server->thread_count], NULL, workerRun, server) == 0)
+            server->thread_count++;
+    }
+    if (server->thread_count == 0)
+        exit(1);
+}
+
+/**
+ * Czeka na zakończenie wątków roboczych i zamyka wszystkie sesje.
+ * @param[in] server : serwer
+ */
+static void stopWorkers(Server *server) {
+    pthread_mutex_lock(&server->lock);
+    server->workers_stop = true;
+    pthread_cond_broadcast(&server->work);
+    pthread_mutex_unlock(&server->lock);
+    for (unsigned i = 0; i < server->thread_count; i++)
+        pthread_join(server->threads[i], NULL);
+    free(server->threads);
+    server->threads = NULL;
+    server->thread_count = 0;
+
+    Session *s;
+    while ((s = queuePop(&server->done)) != NULL)
+        destroySession(s);
+    while ((s = server->idle) != NULL) {
+        server->idle = s->next;
+        destroySession(s);
+    }
+}
+
+void runServer(Server *server) {
+    startWorkers(server);
+    struct pollfd *fds = NULL;
+    Session **polled = NULL;
+    size_t capacity = 0;
+    while (!atomic_load(&server->stop)) {
+        size_t n = 2;
+        for (Session *s = server->idle; s != NULL; s = s->next)
+            n++;
+        if (n > capacity) {
+            capacity = 2 * n;
+            fds = realloc(fds, capacity * sizeof(struct pollfd));
+            polled = realloc(polled, capacity * sizeof(Session *));
+            if (fds == NULL || polled == NULL)
+                exit(1);
+        }
+        fds[0] = (struct pollfd) {.fd = server->wake[0], .events = POLLIN};
+        fds[1] = (struct pollfd) {.fd = server->listen_fd, .events = POLLIN};
+        size_t i = 2;
+        for (Session *s = server->idle; s != NULL; s = s->next, i++) {
+            fds[i] = (struct pollfd) {.fd = s->fd, .events = POLLIN};
+            polled[i] = s;
+        }
+        if (poll(fds, n, -1) < 0 && errno != EINTR)
+            break;
+        if (atomic_load(&server->stop))
+            break;
+
+        // sesje z danymi (lub zamknięte przez klienta) trafiają do wątków roboczych
+        server->idle = NULL;
+        pthread_mutex_lock(&server->lock);
+        for (i = 2; i < n; i++) {
+            Session *s = polled[i];
+            if (fds[i].revents != 0) {
+                queuePush(&server->ready, s);
+                pthread_cond_signal(&server->work);
+            }
+            else {
+                s->next = server->idle;
+                server->idle = s;
+            }
+        }
+        Session *done;
+        while ((done = queuePop(&server->done)) != NULL) {
+            if (done->closed) {
+                destroySession(done);
+                continue;
+            }
+            done->next = server->idle;
+            server->idle = done;
+        }
+        pthread_mutex_unlock(&server->lock);
+
+        if (fds[0].revents != 0) {
+            char drain[64];
+            while (read(server->wake[0], drain, sizeof(drain)) > 0)
+                ;
+        }
+        if (fds[1].revents != 0)
+            acceptSession(server);
+    }
+    free(fds);
+    free(polled);
+    stopWorkers(server);
+}
+
+void stopServer(Server *server) {
+    atomic_store(&server->stop, true);
+    wakeDispatcher(server);
+}
+
+void destroyServer(Server *server) {
+    close(server->listen_fd);
+    unlink(server->config.path);
+    close(server->wake[0]);
+    close(server->wake[1]);
+    pthread_mutex_destroy(&server->lock);
+    pthread_cond_destroy(&server->work);
+    free(server);
+}
@@ -0,0 +1,84 @@
+/** @file
+  Interfejs serwera kalkulatora na gnieździe uniksowym.
+
+  Każde połączenie z serwerem jest osobną sesją z własnym kalkulatorem
+  (a więc własnym stosem), który mówi tym samym protokołem wierszowym co
+  program czytający standardowe wejście: wyniki i komunikaty o błędach
+  są odsyłane tym samym połączeniem. Stos sesji trwa, dopóki klient nie
+  zamknie połączenia.
+
+  Bezczynne połączenia są obserwowane przez jeden wątek (poll), a wiersze,
+  które nadeszły, są wykonywane przez pulę wątków roboczych. Dzięki temu
+  liczba otwartych sesji nie jest ograniczona liczbą wątków. Wiersze
+  jednej sesji są wykonywane po kolei przez jeden wątek naraz.
+
+  Sesja, której wielomiany zajmują więcej pamięci niż limit pamięci sesji
+  albo która zużyła więcej czasu procesora niż limit czasu sesji, dostaje
+  komunikat o błędzie (MEMORY LIMIT lub TIME LIMIT) i jest zamykana.
+  Limit pamięci jest sprawdzany po każdym wierszu, a w trakcie wykonywania
+  instrukcji jest budżetem pamięci kalkulatora sesji (mniejszym z limitu
+  sesji i budżetu --memory): instrukcja, która go przekroczy, kończy się
+  błędem OUT OF MEMORY i nie zmienia stosu. Do czasu sesji jest liczony
+  czas procesora wątku roboczego i wątków puli wykonujących jej zadania.
+  Limit czasu jest sprawdzany także w trakcie mnożenia i obliczania wartości
+  wielomianów: instrukcja, podczas której minie, jest przerywana i nie
+  zmienia stosu.
+
+  Instrukcja CHECKPOINT jest w sesjach niedostępna (kończy się błędem
+  CHECKPOINT FAILED), żeby klient nie mógł zapisywać plików z uprawnieniami
+  serwera.
+*/
+
+#ifndef _SERVER_H
+#define _SERVER_H
+
+#include <stddef.h>
+#include "calculator.h"
+
+/**
+ * Struktura przechowująca ustawienia serwera.
+ */
+typedef struct ServerConfig {
+    const char *path;      ///< ścieżka gniazda
+    unsigned workers;      ///< liczba wątków roboczych (0 - liczba procesorów)
+    size_t session_memory; ///< limit pamięci wielomianów sesji w bajtach (0 - brak)
+    double session_time;   ///< limit czasu procesora sesji w sekundach (0 - brak)
+    CalcOptions calc;      ///< ustawienia kalkulatorów sesji
+} ServerConfig;
+
+/**
+ * Struktura przechowująca serwer.
+ */
+typedef struct Server Server;
+
+/**
+ * Tworzy serwer nasłuchujący na gnieździe o podanej ścieżce. Jeśli pod
+ * tą ścieżką jest już gniazdo, jest ono usuwane.
+ * @param[in] config : ustawienia serwera
+ * @return serwer lub NULL, jeśli nie udało się utworzyć gniazda (wtedy
+ * errno opisuje błąd)
+ */
+Server *makeServer(const ServerConfig *config);
+
+/**
+ * Obsługuje połączenia, dopóki serwer nie zostanie zatrzymany funkcją
+ * stopServer. Po zatrzymaniu czeka na zakończenie wierszy, które są
+ * właśnie wykonywane, i zamyka wszystkie sesje.
+ * @param[in] server : serwer
+ */
+void runServer(Server *server);
+
+/**
+ * Zatrzymuje serwer. Można ją wywołać z innego wątku lub z funkcji
+ * obsługi sygnału.
+ * @param[in] server : serwer
+ */
+void stopServer(Server *server);
+
+/**
+ * Usuwa zatrzymany serwer i jego gniazdo.
+ * @param[in] server : serwer
+ */
+void destroyServer(Server *server);
+
+#endif //_SERVER_H
@@ -1,5 +1,6 @@
 /** @file
-  Implementacja stosu obsługującego elementy typów char, long, Poly oraz Mono.
+  Implementacja stosu obsługującego elementy typów char, long, Poly, Mono
+  oraz leniwe wyrażenia.
 */
 
 #include <stdlib.h>
@@ -91,6 +92,9 @@ void freeStack(struct Stack *st) {
         else if (e->type == MONO) {
             MonoDestroy(&e->m);
         }
+        else if (e->type == EXPR) {
+            PolyExprRelease(e->x);
+        }
         pop(st);
     }
 }
@@ -119,4 +123,14 @@ struct Element elementOfMono (Mono *m) {
 struct Element elementOfNumb (long n) {
     struct Element e = {.type = NUMB, .n = n};
     return e;
+}
+
+struct Element elementOfExpr (PolyExpr *x) {
+    struct Element e = {.type = EXPR, .x = x};
+    return e;
+}
+
+struct Element elementOfSpill (SpillRecord *s) {
+    struct Element e = {.type = SPILL, .s = *s};
+    return e;
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 /** @file
-  Interfejs stosu obsługującego elementy typów char, long, Poly oraz Mono.
+  Interfejs stosu obsługującego elementy typów char, long, Poly, Mono
+  oraz leniwe wyrażenia.
 */
 
 #ifndef _STACK_H
@@ -9,15 +10,20 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include "poly.h"
+#include "poly_expr.h"
+#include "poly_spill.h"
 
 #define CHAR 0
 #define NUMB 1
 #define POLY 2
 #define MONO 3
+#define EXPR 4
+#define SPILL 5
 
 /**
  * Struktura przechowująca element stosu.
- * Element jest znakiem, liczbą całkowitą, wielomianem lub jednomianem
+ * Element jest znakiem, liczbą całkowitą, wielomianem, jednomianem,
+ * leniwym wyrażeniem lub wielomianem wyrzuconym do pliku tymczasowego
  */
 typedef struct Element {
     union {
@@ -25,8 +31,10 @@ typedef struct Element {
         long n;  ///< liczba
         Poly p;  ///< wielomian
         Mono m;  ///< jednomian
+        PolyExpr *x; ///< leniwe wyrażenie
+        SpillRecord s; ///< wielomian wyrzucony do pliku
     } ;
-    int type;  ///< typ elementu (0 - char, 1 - long, 2 - poly, 3 - mono)
+    int type;  ///< typ elementu (0 - char, 1 - long, 2 - poly, 3 - mono, 4 - expr, 5 - spill)
 } Element;
 
 /**
@@ -130,4 +138,18 @@ struct Element elementOfMono (Mono *m);
  */
 struct Element elementOfNumb (long n);
 
+/**
+ * Zwraca element reprezentujący podane leniwe wyrażenie.
+ * @param[in] x : wyrażenie
+ * @return Element reprezentujący podane wyrażenie.
+ */
+struct Element elementOfExpr (PolyExpr *x);
+
+/**
+ * Zwraca element reprezentujący wielomian wyrzucony do pliku.
+ * @param[in] s : opis wyrzuconego wielomianu
+ * @return Element reprezentujący wyrzucony wielomian.
+ */
+struct Element elementOfSpill (SpillRecord *s);
+
 #endif //_STACK_H
@@ -0,0 +1,351 @@
+/** @file
+  Implementacja puli wątków z podkradaniem zadań.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "work_pool.h"
+#include "poly_trace.h"
+
+/** Początkowa pojemność kolejki zadań wątku. */
+#define DEQUE_INIT_SIZE 16
+
+/**
+ * Struktura przechowująca zadanie.
+ */
+typedef struct WorkTask {
+    WorkFunc fn;      ///< funkcja zadania
+    void *arg;        ///< argument funkcji
+    WorkGroup *group; ///< grupa zadania lub NULL dla zadań dodanych WorkPoolSubmit
+} WorkTask;
+
+/**
+ * Struktura przechowująca kolejkę zadań jednego wątku (bufor cykliczny).
+ * Właściciel zdejmuje zadania z końca, inne wątki podkradają je
+ * z początku.
+ */
+typedef struct WorkDeque {
+    pthread_mutex_t lock; ///< blokada kolejki
+    WorkTask *tasks;      ///< bufor zadań
+    size_t head;          ///< pozycja pierwszego zadania
+    size_t count;         ///< liczba zadań
+    size_t capacity;      ///< pojemność bufora
+} WorkDeque;
+
+/**
+ * Struktura przechowująca argument wątku puli.
+ */
+typedef struct WorkThread {
+    WorkPool *pool;   ///< pula
+    unsigned index;   ///< numer wątku w puli
+    pthread_t thread; ///< wątek
+} WorkThread;
+
+struct WorkPool {
+    unsigned count;        ///< liczba wątków
+    WorkDeque *deques;     ///< kolejki zadań kolejnych wątków i (na końcu) kolejka
+                           ///< zadań dodanych przez wątki spoza puli
+    WorkThread *threads;   ///< wątki
+    atomic_size_t queued;  ///< liczba zadań w kolejkach
+    atomic_uint sleeping;  ///< liczba uśpionych wątków
+    pthread_mutex_t lock;  ///< blokada chroniąca pending, stop i usypianie wątków
+    pthread_cond_t wake;   ///< sygnalizuje nowe zadania lub zatrzymanie
+    pthread_cond_t idle;   ///< sygnalizuje wykonanie wszystkich zadań
+    size_t pending;        ///< liczba dodanych, jeszcze niewykonanych zadań
+    bool stop;             ///< czy wątki mają się zakończyć
+};
+
+/** Pula, do której należy bieżący wątek, lub NULL. */
+static _Thread_local WorkPool *current_pool = NULL;
+
+/** Numer bieżącego wątku w jego puli. */
+static _Thread_local unsigned current_index = 0;
+
+/** Wspólna pula wątków. */
+static WorkPool *shared_pool = NULL;
+
+/** Zapewnia jednokrotne utworzenie wspólnej puli. */
+static pthread_once_t shared_once = PTHREAD_ONCE_INIT;
+
+/**
+ * Wstawia zadanie na koniec kolejki.
+ * @param[in] d : kolejka
+ * @param[in] task : zadanie
+ */
+static void DequePush(WorkDeque *d, WorkTask task) {
+    pthread_mutex_lock(&d->lock);
+    if (d->count == d->capacity) {
+        size_t capacity = d->capacity == 0 ? DEQUE_INIT_SIZE : 2 * d->capacity;
+        WorkTask *tasks = malloc(capacity * sizeof(WorkTask));
+        if (tasks == NULL)
+            exit(1);
+        for (size_t i = 0; i < d->count; i++)
+            tasks[i] = d->tasks[(d->head + i) % d->capacity];
+        free(d->tasks);
+        d->tasks = tasks;
+        d->head = 0;
+        d->capacity = capacity;
+    }
+    d->tasks[(d->head + d->count) % d->capacity] = task;
+    d->count++;
+    pthread_mutex_unlock(&d->lock);
+}
+
+/**
+ * Zdejmuje zadanie z kolejki.
+ * @param[in] d : kolejka
+ * @param[in] steal : czy zdjąć pierwsze zadanie (w przeciwnym razie ostatnie)
+ * @param[in] group : grupa, do której musi należeć zadanie, lub NULL,
+ * jeśli może to być dowolne zadanie
+ * @param[out] task : zdjęte zadanie
+ * @return Czy zdjęto zadanie?
+ */
+static bool DequeTake(WorkDeque *d, bool steal, const WorkGroup *group, WorkTask *task) {
+    pthread_mutex_lock(&d->lock);
+    bool found = false;
+    if (d->count > 0) {
+        size_t i = steal ? d->head : (d->head + d->count - 1) % d->capacity;
+        found = group == NULL || d->tasks[i].group == group;
+        if (found) {
+            *task = d->tasks[i];
+            d->count--;
+            if (steal)
+                d->head = (d->head + 1) % d->capacity;
+        }
+    }
+    pthread_mutex_unlock(&d->lock);
+    return found;
+}
+
+/**
+ * Daje numer kolejki, do której bieżący wątek dodaje zadania.
+ * @param[in] pool : pula
+ * @return numer kolejki
+ */
+static unsigned WorkPoolSelf(const WorkPool *pool) {
+    return current_pool == pool ? current_index : pool->count;
+}
+
+/**
+ * Znajduje zadanie dla bieżącego wątku. Zadanie grupy jest szukane
+ * tylko w kolejce, do której dodaje zadania bieżący wątek: tam trafiły
+ * wszystkie zadania jego grupy. Dowolne zadanie jest szukane najpierw na
+ * końcu własnej kolejki, potem na początku pozostałych.
+ * @param[in] pool : pula
+ * @param[in] group : grupa, do której musi należeć zadanie, lub NULL
+ * @param[out] task : znalezione zadanie
+ * @return Czy znaleziono zadanie?
+ */
+static bool WorkPoolFind(WorkPool *pool, const WorkGroup *group, WorkTask *task) {
+    if (atomic_load(&pool->queued) == 0)
+        return false;
+    unsigned self = WorkPoolSelf(pool);
+    bool found = DequeTake(&pool->deques[self], false, group, task);
+    // kolejka wątków spoza puli jest wspólna, więc zadania grupy mogą
+    // w niej leżeć także przed zadaniami innych wątków
+    if (!found && group != NULL && self == pool->count)
+        found = DequeTake(&pool->deques[self], true, group, task);
+    for (unsigned i = 1; !found && group == NULL && i <= pool->count; i++)
+        found = DequeTake(&pool->deques[(self + i) % (pool->count + 1)], true, NULL, task);
+    if (found)
+        atomic_fetch_sub(&pool->queued, 1);
+    return found;
+}
+
+/**
+ * Wykonuje zadanie i zaznacza, że zostało wykonane.
+ * @param[in] pool : pula
+ * @param[in] task : zadanie
+ */
+static void WorkPoolRunTask(WorkPool *pool, WorkTask task) {
+    if (task.group != NULL) {
+        WorkGroup *g = task.group;
+        MonosContext context = MonosSetContext(g->context);
+        long line = TraceSetLine(g->trace_line);
+        uint64_t start = MonosChargeBegin();
+        task.fn(task.arg);
+        MonosChargeEnd(start);
+        TraceSetLine(line);
+        MonosSetContext(context);
+        pthread_mutex_lock(&g->lock);
+        if (atomic_fetch_sub(&g->pending, 1) == 1)
+            pthread_cond_broadcast(&g->done);
+        pthread_mutex_unlock(&g->lock);
+        return;
+    }
+    task.fn(task.arg);
+    pthread_mutex_lock(&pool->lock);
+    if (--pool->pending == 0)
+        pthread_cond_broadcast(&pool->idle);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/**
+ * Wstawia zadanie do kolejki bieżącego wątku (lub do wspólnej kolejki
+ * wątków spoza puli) i budzi uśpiony wątek.
+ * @param[in] pool : pula
+ * @param[in] task : zadanie
+ */
+static void WorkPoolPush(WorkPool *pool, WorkTask task) {
+    DequePush(&pool->deques[WorkPoolSelf(pool)], task);
+    atomic_fetch_add(&pool->queued, 1);
+
+    // wątek zasypiający zwiększa sleeping przed sprawdzeniem queued, więc
+    // albo zobaczy nowe zadanie, albo zostanie tu obudzony; sygnał jest
+    // wysyłany pod blokadą, żeby trafił do wątku, który już czeka
+    if (atomic_load(&pool->sleeping) > 0) {
+        pthread_mutex_lock(&pool->lock);
+        pthread_cond_signal(&pool->wake);
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+/**
+ * Funkcja wątku puli: wykonuje zadania, aż pula zostanie zatrzymana.
+ * @param[in] arg : argument wątku
+ * @return NULL
+ */
+static void *WorkPoolRun(void *arg) {
+    WorkThread *self = arg;
+    WorkPool *pool = self->pool;
+    current_pool = pool;
+    current_index = self->index;
+    for (;;) {
+        WorkTask task;
+        if (WorkPoolFind(pool, NULL, &task)) {
+            WorkPoolRunTask(pool, task);
+            continue;
+        }
+        pthread_mutex_lock(&pool->lock);
+        atomic_fetch_add(&pool->sleeping, 1);
+        while (atomic_load(&pool->queued) == 0 && !pool->stop)
+            pthread_cond_wait(&pool->wake, &pool->lock);
+        atomic_fetch_sub(&pool->sleeping, 1);
+        bool stop = pool->stop && atomic_load(&pool->queued) == 0;
+        pthread_mutex_unlock(&pool->lock);
+        if (stop)
+            break;
+    }
+    current_pool = NULL;
+    MonosPoolRelease();
+    return NULL;
+}
+
+WorkPool *WorkPoolMake(unsigned threads) {
+    if (threads == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? (unsigned)cpus : 1;
+    }
+    WorkPool *pool = calloc(1, sizeof(WorkPool));
+    if (pool == NULL)
+        exit(1);
+    pool->deques = calloc(threads + 1, sizeof(WorkDeque));
+    pool->threads = calloc(threads, sizeof(WorkThread));
+    if (pool->deques == NULL || pool->threads == NULL)
+        exit(1);
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    pthread_cond_init(&pool->idle, NULL);
+    for (unsigned i = 0; i <= threads; i++)
+        pthread_mutex_init(&pool->deques[i].lock, NULL);
+    for (unsigned i = 0; i < threads; i++) {
+        pool->threads[pool->count] = (WorkThread) {.pool = pool, .index = pool->count};
+        if (pthread_create(&pool->threads[pool->count].thread, NULL, WorkPoolRun,
+                           &pool->threads[pool->count]) == 0)
+            pool->count++;
+    }
+    if (pool->count == 0)
+        exit(1);
+    return pool;
+}
+
+unsigned WorkPoolThreads(const WorkPool *pool) {
+    return pool->count;
+}
+
+void WorkPoolSubmit(WorkPool *pool, WorkFunc fn, void *arg) {
+    pthread_mutex_lock(&pool->lock);
+    pool->pending++;
+    pthread_mutex_unlock(&pool->lock);
+    WorkPoolPush(pool, (WorkTask) {.fn = fn, .arg = arg, .group = NULL});
+}
+
+void WorkPoolWait(WorkPool *pool) {
+    pthread_mutex_lock(&pool->lock);
+    while (pool->pending > 0)
+        pthread_cond_wait(&pool->idle, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void WorkPoolDestroy(WorkPool *pool) {
+    WorkPoolWait(pool);
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = true;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+    for (unsigned i = 0; i < pool->count; i++)
+        pthread_join(pool->threads[i].thread, NULL);
+    for (unsigned i = 0; i <= pool->count; i++) {
+        pthread_mutex_destroy(&pool->deques[i].lock);
+        free(pool->deques[i].tasks);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->wake);
+    pthread_cond_destroy(&pool->idle);
+    free(pool->deques);
+    free(pool->threads);
+    free(pool);
+}
+
+/**
+ * Tworzy wspólną pulę wątków.
+ */
+static void WorkPoolSharedInit(void) {
+    shared_pool = WorkPoolMake(0);
+}
+
+WorkPool *WorkPoolShared(void) {
+    pthread_once(&shared_once, WorkPoolSharedInit);
+    return shared_pool;
+}
+
+void WorkGroupInit(WorkGroup *g, WorkPool *pool) {
+    g->pool = pool;
+    atomic_init(&g->pending, 0);
+    pthread_mutex_init(&g->lock, NULL);
+    pthread_cond_init(&g->done, NULL);
+    g->context = MonosGetContext();
+    g->trace_line = TraceGetLine();
+}
+
+void WorkGroupSpawn(WorkGroup *g, WorkFunc fn, void *arg) {
+    atomic_fetch_add(&g->pending, 1);
+    WorkPoolPush(g->pool, (WorkTask) {.fn = fn, .arg = arg, .group = g});
+}
+
+void WorkGroupJoin(WorkGroup *g) {
+    // czekający wątek wykonuje tylko zadania własnej grupy: wykonywanie
+    // cudzych zadań zagnieżdżałoby na jego stosie dowolnie wiele operacji;
+    // pozostałe zadania grupy wykonają inne wątki
+    while (atomic_load(&g->pending) > 0) {
+        WorkTask task;
+        if (WorkPoolFind(g->pool, g, &task)) {
+            WorkPoolRunTask(g->pool, task);
+            continue;
+        }
+        pthread_mutex_lock(&g->lock);
+        while (atomic_load(&g->pending) > 0)
+            pthread_cond_wait(&g->done, &g->lock);
+        pthread_mutex_unlock(&g->lock);
+    }
+    // wątek, który wykonał ostatnie zadanie, mógł jeszcze nie zwolnić blokady
+    pthread_mutex_lock(&g->lock);
+    pthread_mutex_unlock(&g->lock);
+    pthread_mutex_destroy(&g->lock);
+    pthread_cond_destroy(&g->done);
+}
@@ -0,0 +1,123 @@
+/** @file
+  Interfejs puli wątków z podkradaniem zadań.
+
+  Każdy wątek puli ma własną kolejkę zadań z dwoma końcami. Wątek bierze
+  zadania z końca swojej kolejki (najpóźniej dodane), a gdy jest ona
+  pusta, podkrada najwcześniej dodane zadanie z kolejki innego wątku.
+  Dzięki temu kilka dużych zadań nie blokuje reszty: wątki, które
+  skończyły swoją pracę, przejmują zadania czekające u pozostałych.
+  Zadanie dodane przez wątek puli trafia do jego własnej kolejki, a dodane
+  z zewnątrz - do wspólnej kolejki, z której wątki zabierają zadania
+  w kolejności dodania.
+
+  Zadania mogą też być uruchamiane w modelu fork-join: zadania dodane do
+  grupy (WorkGroupSpawn) są wykonywane współbieżnie, a WorkGroupJoin
+  czeka na ich zakończenie. Zadania grupy są wykonywane w kontekście
+  wątku, który utworzył grupę: z jego budżetem pamięci (MonosContext)
+  i numerem śledzonego wiersza. Czekający wątek w tym czasie sam wykonuje
+  niepodkradzione zadania swojej grupy (ale nie cudze, żeby nie zagnieżdżać
+  na swoim stosie dowolnie wielu operacji).
+  Operacje na wielomianach korzystają ze wspólnej puli (WorkPoolShared).
+
+  Wątek puli, kończąc pracę, oddaje swoją pulę bloków pamięci
+  (MonosPoolRelease).
+*/
+
+#ifndef _WORK_POOL_H
+#define _WORK_POOL_H
+
+#include <stdatomic.h>
+#include <pthread.h>
+#include "monos.h"
+
+/**
+ * Typ funkcji wykonującej zadanie.
+ * @param[in] arg : argument zadania
+ */
+typedef void (*WorkFunc)(void *arg);
+
+/**
+ * Struktura przechowująca pulę wątków.
+ */
+typedef struct WorkPool WorkPool;
+
+/**
+ * Struktura przechowująca grupę zadań fork-join.
+ */
+typedef struct WorkGroup {
+    WorkPool *pool;        ///< pula wykonująca zadania
+    atomic_size_t pending; ///< liczba niewykonanych zadań grupy
+    pthread_mutex_t lock;  ///< blokada do czekania na zadania
+    pthread_cond_t done;   ///< sygnalizuje wykonanie wszystkich zadań
+    MonosContext context;  ///< kontekst przydziałów wątku tworzącego grupę
+    long trace_line;       ///< numer śledzonego wiersza wątku tworzącego grupę
+} WorkGroup;
+
+/**
+ * Tworzy pulę wątków i uruchamia jej wątki.
+ * @param[in] threads : liczba wątków (0 - liczba procesorów)
+ * @return pula wątków
+ */
+WorkPool *WorkPoolMake(unsigned threads);
+
+/**
+ * Daje liczbę wątków puli.
+ * @param[in] pool : pula wątków
+ * @return liczba wątków
+ */
+unsigned WorkPoolThreads(const WorkPool *pool);
+
+/**
+ * Dodaje zadanie do wykonania przez pulę.
+ * @param[in] pool : pula wątków
+ * @param[in] fn : funkcja zadania
+ * @param[in] arg : argument przekazywany funkcji
+ */
+void WorkPoolSubmit(WorkPool *pool, WorkFunc fn, void *arg);
+
+/**
+ * Czeka, aż pula wykona wszystkie dodane zadania (także te dodane
+ * w trakcie oczekiwania przez same zadania). Nie może być wywołana przez
+ * wątek puli.
+ * @param[in] pool : pula wątków
+ */
+void WorkPoolWait(WorkPool *pool);
+
+/**
+ * Czeka na wykonanie wszystkich zadań, zatrzymuje wątki i usuwa pulę.
+ * @param[in] pool : pula wątków
+ */
+void WorkPoolDestroy(WorkPool *pool);
+
+/**
+ * Daje wspólną pulę wątków (o liczbie wątków równej liczbie procesorów),
+ * tworząc ją przy pierwszym wywołaniu. Pula działa do końca programu.
+ * @return wspólna pula wątków
+ */
+WorkPool *WorkPoolShared(void);
+
+/**
+ * Tworzy pustą grupę zadań. Zapamiętuje kontekst bieżącego wątku, w którym
+ * będą wykonywane jej zadania.
+ * @param[in] g : grupa
+ * @param[in] pool : pula, która wykona zadania grupy
+ */
+void WorkGroupInit(WorkGroup *g, WorkPool *pool);
+
+/**
+ * Dodaje zadanie do grupy. Zadania grupy może dodawać tylko wątek, który
+ * potem na nie czeka.
+ * @param[in] g : grupa
+ * @param[in] fn : funkcja zadania
+ * @param[in] arg : argument przekazywany funkcji
+ */
+void WorkGroupSpawn(WorkGroup *g, WorkFunc fn, void *arg);
+
+/**
+ * Czeka na wykonanie wszystkich zadań grupy, w międzyczasie wykonując
+ * jej zadania, których nie podkradły inne wątki, i usuwa grupę.
+ * @param[in] g : grupa
+ */
+void WorkGroupJoin(WorkGroup *g);
+
+#endif //_WORK_POOL_H